@@ -0,0 +1,24 @@
+10 REM MAT VERSUS FOR LOOPS
+20 N=200
+30 DIM A(N,N),B(N,N),C(N,N)
+40 FOR I=0 TO N:FOR J=0 TO N:A(I,J)=I+J:B(I,J)=I-J:NEXT:NEXT
+50 PRINT "ADD ";N+1;"X";N+1
+60 T=TI:FOR I=0 TO N:FOR J=0 TO N:C(I,J)=A(I,J)+B(I,J):NEXT:NEXT:T1=TI-T
+70 T=TI:MAT C=A+B:T2=TI-T
+80 PRINT "  FOR:";T1;"  MAT:";T2
+90 PRINT "SUM"
+100 T=TI:S=0:FOR I=0 TO N:FOR J=0 TO N:S=S+A(I,J):NEXT:NEXT:T1=TI-T
+110 T=TI:MAT S2=SUM(A):T2=TI-T
+120 PRINT "  FOR:";T1;"  MAT:";T2;"  ";S=S2
+130 M=40:DIM P(M,M),Q(M,M),R(M,M)
+140 FOR I=0 TO M:FOR J=0 TO M:P(I,J)=RND(1):Q(I,J)=RND(1):NEXT:NEXT
+150 PRINT "MULTIPLY ";M+1;"X";M+1
+160 T=TI
+170 FOR I=0 TO M:FOR J=0 TO M:S=0
+180 FOR K=0 TO M:S=S+P(I,K)*Q(K,J):NEXT:R(I,J)=S
+190 NEXT:NEXT:T1=TI-T
+200 T=TI:MAT R=P*Q:T2=TI-T
+210 PRINT "  FOR:";T1;"  MAT:";T2
+220 PRINT "LARGE MULTIPLY 500X500"
+230 MAT X=CON(499,499):MAT Y=IDN(499,499)
+240 T=TI:MAT Z=X*Y:PRINT "  MAT:";TI-T
@@ -4,9 +4,13 @@
 #include "os.h"
 #include "string_helper.h"
 #include "unicode.h"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <new>
 #include <regex>
 #include <variant>
 #include "prg_tool.h"
@@ -17,6 +21,7 @@
 #include "rawconfig.h"
 #include "rom.h"
 #include "cbm_rnd.h"
+#include "mat_kernels.h"
 
 #include "parse_string.h"
 
@@ -53,6 +58,7 @@ void runAssemblerCode(Basic* basic) {
 
     auto& cpu       = basic->cpu;
     cpu.ROM[0xE48D] = 0x53; // C64 BASIC ROM identifier
+    basic->os->pokeKeyboardBuffer();
 
     for (;;) {
         auto PC = cpu.PC;
@@ -73,6 +79,7 @@ void runAssemblerCode(Basic* basic) {
 
         case 0XF142: // CHIN - get character from keyboard
             basic->os->updateEvents(); // pokes to keyboard buffer
+            basic->os->pokeKeyboardBuffer();
             //            if (basic->os->peekKeyboardBuffer().code != 0) {
             //                cpu.A = uint8_t(basic->os->getFromKeyboardBuffer().code);
             //            }
@@ -165,6 +172,7 @@ void runAssemblerCode(Basic* basic) {
         if (++counter == 0xff) {
             counter = 0;
             basic->os->updateEvents();
+            basic->os->pokeKeyboardBuffer();
             basic->os->presentScreen();
 
             // basic->handleEscapeKey();
@@ -687,8 +695,8 @@ void CHARDEF(Basic* basic, const std::vector<BA67::Value>& values) {
     // TODO #error ARM is big endian?
     char32_t codePoint = 0;
     uint64_t bytes8;
-    static std::array<uint8_t, 32> bytes;
-    static std::array<uint32_t, 16> dwords;
+    std::array<uint8_t, 32> bytes   = {};
+    std::array<uint32_t, 16> dwords = {};
     size_t iarg = 0;
     for (size_t i = 0; i < values.size(); ++i) {
         if (iarg > 16) {
@@ -751,7 +759,7 @@ void SPRDEF(Basic* basic, const std::vector<BA67::Value>& values) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
     }
     int id = int(ValueToInt(values[0]));
-    if (id < 1 || id > basic->os->screen.sprites.size()) {
+    if (id < 1 || id >= int(basic->os->screen.sprites.size())) {
         throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
     }
     std::string str = ValueToString(values[2]);
@@ -769,7 +777,8 @@ void SPRDEF(Basic* basic, const std::vector<BA67::Value>& values) {
         throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
     }
 
-    basic->os->screen.dirtyFlag = true;
+    basic->os->screen.dirtyFlag      = true;
+    basic->os->screen.spritesChanged = true;
 }
 
 void SPRITE(Basic* basic, const std::vector<BA67::Value>& values) {
@@ -786,21 +795,21 @@ void SPRITE(Basic* basic, const std::vector<BA67::Value>& values) {
         int64_t iv = BA67::ValueToInt(v);
         switch (ipara) {
         case 0:
-            if (iv < 1 || iv > int64_t(basic->os->screen.sprites.size())) {
+            if (iv < 1 || iv >= int64_t(basic->os->screen.sprites.size())) {
                 throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
             }
             sprite = &basic->os->screen.sprites[iv];
             break;
         case 1: sprite->enabled = (iv != 0); break;
         case 2: sprite->color = iv & 0x0f; break;
-        case 3: break; // prio
+        case 3: sprite->behindText = (iv != 0); break; // prio
         case 4: sprite->stretchX = (iv != 0); break;
         case 5: sprite->stretchY = (iv != 0); break;
         default:
             throw BA67::Error(ErrorId::ARGUMENT_COUNT);
         }
     }
-    basic->os->screen.dirtyFlag = true;
+    basic->os->screen.updateActiveSprites();
 }
 
 void MOVSPR(Basic* basic, const std::vector<BA67::Value>& values) {
@@ -816,7 +825,7 @@ void MOVSPR(Basic* basic, const std::vector<BA67::Value>& values) {
         int64_t iv = BA67::ValueToInt(v);
         switch (ipara) {
         case 0:
-            if (iv < 1 || iv > int64_t(basic->os->screen.sprites.size())) {
+            if (iv < 1 || iv >= int64_t(basic->os->screen.sprites.size())) {
                 throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
             }
             sprite = &basic->os->screen.sprites[iv];
@@ -826,7 +835,26 @@ void MOVSPR(Basic* basic, const std::vector<BA67::Value>& values) {
         default: throw BA67::Error(ErrorId::ARGUMENT_COUNT);
         }
     }
-    basic->os->screen.dirtyFlag = true;
+    basic->os->screen.dirtyFlag      = true;
+    basic->os->screen.spritesChanged = true;
+}
+
+void COLLISION(Basic* basic, const std::vector<BA67::Value>& values) {
+    // COLLISION type [, line]. type 1: sprite-sprite, 2: sprite-background
+    std::vector<int64_t> args;
+    for (auto& v : values) {
+        if (!ValueIsOperator(v)) {
+            args.push_back(BA67::ValueToInt(v));
+        }
+    }
+    if (args.empty() || args.size() > 2) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    if (args[0] < 1 || args[0] > 2) {
+        throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
+    }
+    basic->collisionLine[args[0] - 1]    = args.size() == 2 ? int(args[1]) : -1;
+    basic->collisionPending[args[0] - 1] = false;
 }
 void MONITOR(Basic* basic, const std::vector<BA67::Value>& values) {
     if (basic->monitor()) {
@@ -839,6 +867,14 @@ void QUIT(Basic* basic, const std::vector<BA67::Value>& values) {
     if (values.size() == 1) {
         code = int(BA67::ValueToInt(values[0]));
     }
+    if (basic->os->settings.benchmark) {
+        basic->quitCode = code;
+        basic->currentModule().setProgramCounterToEnd();
+        return;
+    }
+    if (basic->os->settings.batchMode) {
+        code = basic->finishBatch(code);
+    }
     exit(code);
 }
 
@@ -901,9 +937,8 @@ void GO(Basic* basic, const std::vector<BA67::Value>& values) {
         basic->os->screen.setSize(40, 25);
         basic->os->screen.clear();
 
-        static bool mustReset = true;
-        if (mustReset) {
-            mustReset = false;
+        if (basic->c64ModeNeedsReset) {
+            basic->c64ModeNeedsReset = false;
             // $FCE2 system cold start
             CMD::SYS(basic, { 0xFCE2 });
         } else {
@@ -1440,6 +1475,82 @@ void SOUND(Basic* basic, const std::vector<BA67::Value>& values) {
     basic->os->soundSystem().SOUND(voice, cmd);
 }
 
+// SEND name$, value [, value...] - to a worker, or from a worker to "PARENT".
+// Waits while the channel is full.
+void SEND(Basic* basic, const std::vector<BA67::Value>& values) {
+    if (values.size() < 3) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    Channel *in, *out;
+    basic->channelsOf(ValueToString(values[0]), in, out);
+    for (size_t i = 2; i < values.size(); ++i) {
+        if (ValueIsOperator(values[i])) {
+            continue;
+        }
+        for (;;) {
+            if (out->closed()) {
+                throw BA67::Error(ErrorId::FILE_NOT_OPEN); // the worker ended
+            }
+            if (out->tryPush(values[i])) {
+                break;
+            }
+            basic->waitForChannel(*out);
+        }
+    }
+}
+
+// STATS                    - print the counters
+// STATS file$ [, seconds]  - append them to a file, repeat every n seconds. 0 stops.
+void STATS(Basic* basic, const std::vector<BA67::Value>& values) {
+    if (values.empty()) {
+        basic->printUtf8String(basic->statsText());
+        return;
+    }
+    if (values.size() != 1 && values.size() != 3) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    int64_t seconds = values.size() == 3 ? ValueToInt(values[2]) : 0;
+    if (seconds < 0) {
+        throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
+    }
+    basic->statsFile       = ValueToString(values[0]);
+    basic->statsIntervalMs = uint64_t(seconds) * 1000;
+    basic->dumpStats();
+}
+
+// TRON [file$ [, variables]] - record the statements in Basic::traceRing.
+// The ring is written to file$ (default "trace.txt") on errors and TROFF.
+void TRON(Basic* basic, const std::vector<BA67::Value>& values) {
+    if (values.size() != 0 && values.size() != 1 && values.size() != 3) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    auto& ring     = basic->traceRing;
+    ring.file      = values.empty() ? std::string("trace.txt") : ValueToString(values[0]);
+    ring.variables = values.size() == 3 && ValueToInt(values[2]) != 0;
+    ring.start();
+    basic->moduleVariableStack.back()->second.traceOn = true;
+}
+
+void TROFF(Basic* basic, const std::vector<BA67::Value>&) {
+    basic->moduleVariableStack.back()->second.traceOn = false;
+    if (basic->traceRing.running()) {
+        std::string file = basic->traceRing.file;
+        basic->dumpTrace(file, "TROFF\n");
+        basic->traceRing.stop();
+    }
+}
+
+// TRACE [file$] - write the trace ring now
+void TRACE(Basic* basic, const std::vector<BA67::Value>& values) {
+    if (values.size() > 1) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    if (!basic->traceRing.running()) {
+        throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
+    }
+    basic->dumpTrace(values.empty() ? basic->traceRing.file : ValueToString(values[0]), "");
+}
+
 void SYS(Basic* basic, const std::vector<BA67::Value>& values) {
     if (values.size() == 0) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
@@ -1532,6 +1643,15 @@ void SYS(Basic* basic, const std::vector<BA67::Value>& values) {
 
 namespace FKT {
 
+// a string argument without a copy. Numbers are converted into 'buffer'.
+static const std::string& stringArgument(const BA67::Value& v, std::string& buffer) {
+    if (auto s = std::get_if<std::string>(&v)) {
+        return *s;
+    }
+    buffer = ValueToString(v);
+    return buffer;
+}
+
 BA67::Value CHR$(Basic* basic, const std::vector<BA67::Value>& args) {
     if (args.size() < 1 || args.size() > 3) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
@@ -1593,14 +1713,15 @@ BA67::Value INSTR(Basic* basic, const std::vector<BA67::Value>& args) {
     }
     size_t startOffset = 1;
     if (args.size() == 5) {
-        startOffset = ValueToInt(args[6]);
+        startOffset = ValueToInt(args[4]);
     }
 
     if (startOffset < 1) {
         throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
     }
 
-    auto pos = Unicode::strstr(ValueToString(args[0]), ValueToString(args[2]), startOffset - 1);
+    std::string buf0, buf2;
+    auto pos = Unicode::strstr(stringArgument(args[0], buf0), stringArgument(args[2], buf2), startOffset - 1);
     // INSTR is on index, base 1.
     if (pos == std::string::npos) {
         return 0;
@@ -1608,6 +1729,40 @@ BA67::Value INSTR(Basic* basic, const std::vector<BA67::Value>& args) {
     return int64_t(pos + 1);
 }
 
+BA67::Value BUMP(Basic* basic, const std::vector<BA67::Value>& args) {
+    // BUMP(type [, sprite]). type 1: sprite-sprite, 2: sprite-background
+    if (args.size() != 1 && args.size() != 3) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    int64_t type = ValueToInt(args[0]);
+    if (type < 1 || type > 2) {
+        throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
+    }
+    auto& screen = basic->os->screen;
+    screen.detectCollisions();
+    auto& bits = type == 1 ? screen.spriteCollisions : screen.backgroundCollisions;
+
+    if (args.size() == 3) {
+        int64_t nr = ValueToInt(args[2]);
+        if (nr < 1 || nr >= int64_t(screen.sprites.size())) {
+            throw BA67::Error(ErrorId::ILLEGAL_QUANTITY);
+        }
+        bool hit = bits.test(size_t(nr));
+        bits.reset(size_t(nr));
+        return int64_t(hit ? -1 : 0);
+    }
+
+    // C128 style: bit 0 is sprite 1
+    int64_t mask = 0;
+    for (size_t nr = 1; nr <= 8; ++nr) {
+        if (bits.test(nr)) {
+            mask |= int64_t(1) << (nr - 1);
+            bits.reset(nr);
+        }
+    }
+    return mask;
+}
+
 BA67::Value JOY(Basic* basic, const std::vector<BA67::Value>& args) {
     if (args.size() != 1) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
@@ -1724,7 +1879,8 @@ BA67::Value LEFT$(Basic* basic, const std::vector<BA67::Value>& args) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
     }
     size_t length = ValueToInt(args[2]);
-    return Unicode::substr(ValueToString(args[0]), 0, length);
+    std::string buf;
+    return Unicode::substr(stringArgument(args[0], buf), 0, length);
 }
 
 BA67::Value MID$(Basic* basic, const std::vector<BA67::Value>& args) {
@@ -1742,16 +1898,63 @@ BA67::Value MID$(Basic* basic, const std::vector<BA67::Value>& args) {
     if (args.size() == 5) {
         length = ValueToInt(args[4]);
     }
-    return Unicode::substr(ValueToString(args[0]), start, length);
+    std::string buf;
+    return Unicode::substr(stringArgument(args[0], buf), start, length);
+}
+
+// POLL(name$) - values waiting from "PARENT" or a worker. -1: none and the worker ended.
+BA67::Value POLL(Basic* basic, const std::vector<BA67::Value>& args) {
+    if (args.size() != 1) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    Channel *in, *out;
+    basic->channelsOf(ValueToString(args[0]), in, out);
+    bool closed = in->closed(); // before size(): the last values are sent before the close
+    size_t n    = in->size();
+    return (n == 0 && closed) ? int64_t(-1) : int64_t(n);
+}
+
+// RECV(name$), RECV$(name$) - the next value. Waits for one.
+static BA67::Value receive(Basic* basic, const std::vector<BA67::Value>& args, bool wantString) {
+    if (args.size() != 1) {
+        throw BA67::Error(ErrorId::ARGUMENT_COUNT);
+    }
+    Channel *in, *out;
+    basic->channelsOf(ValueToString(args[0]), in, out);
+    BA67::Value value;
+    for (;;) {
+        bool closed = in->closed();
+        switch (in->tryPop(value, wantString)) {
+        case Channel::Pop::OK:
+            return value;
+        case Channel::Pop::WRONG_TYPE:
+            throw BA67::Error(ErrorId::TYPE_MISMATCH); // the value stays for the other RECV
+        case Channel::Pop::EMPTY:
+            if (closed) {
+                throw BA67::Error(ErrorId::OUT_OF_DATA);
+            }
+            basic->waitForChannel(*in);
+            break;
+        }
+    }
+}
+
+BA67::Value RECV(Basic* basic, const std::vector<BA67::Value>& args) {
+    return receive(basic, args, false);
+}
+
+BA67::Value RECV$(Basic* basic, const std::vector<BA67::Value>& args) {
+    return receive(basic, args, true);
 }
 
 BA67::Value RIGHT$(Basic* basic, const std::vector<BA67::Value>& args) {
     if (args.size() != 3) {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
     }
-    size_t right    = ValueToInt(args[2]);
-    std::string str = ValueToString(args[0]);
-    size_t length   = Unicode::utf8StrLen(str);
+    size_t right           = ValueToInt(args[2]);
+    std::string buf;
+    const std::string& str = stringArgument(args[0], buf);
+    size_t length          = Unicode::utf8StrLen(str);
     if (right >= length) {
         return str;
     }
@@ -1766,12 +1969,12 @@ BA67::Value RND(Basic* basic, const std::vector<BA67::Value>& args) {
 
     double f = ValueToDouble(args[0]);
     if (f == 0) {
-        f = int(basic->os->tick()) + cbm_rnd(1.0);
+        f = int(basic->os->tick()) + cbm_rnd(basic->rndCpu, 1.0);
         if (f >= 0) {
             f = -f - 1.11123e-9;
         }
     }
-    return cbm_rnd(f);
+    return cbm_rnd(basic->rndCpu, f);
 }
 
 
@@ -1853,53 +2056,65 @@ void Basic::Array::dim(Value init, size_t i0, size_t i1, size_t i2, size_t i3) {
 void Basic::Array::dim(Value init, const ArrayIndex& ai) {
     setIsDictionary(false);
     this->bounds.index = ai.index;
-    size_t elems       = 1 + ai.index[0]; // add the end element, too. dim a(5) = 0..5
+    size_t elems       = 1;
     size_t old         = elems;
     try {
-        for (size_t n = 1; n < ai.index.size(); ++n) {
-            if (ai.index[n] != 0) {
-                elems *= (1 + ai.index[n]);
-            }
+        // add the end element, too. dim a(5) = 0..5
+        for (size_t n = 0; n < ai.index.size(); ++n) {
+            strides[n] = elems;
+            elems *= (1 + ai.index[n]);
             if (elems < old) {
                 throw Error(ErrorId::ILLEGAL_QUANTITY);
             }
             old = elems;
         }
 
-        data.clear();
-        data.resize(elems);
-        for (auto& v : data) {
-            v = init;
+        doubles.clear();
+        integers.clear();
+        strings.clear();
+        if (ValueIsString(init)) {
+            type = ElementType::String;
+            strings.resize(elems, ValueToString(init));
+        } else if (ValueIsInt(init)) {
+            type = ElementType::Integer;
+            integers.resize(elems, ValueToInt(init));
+        } else {
+            type = ElementType::Double;
+            doubles.resize(elems, ValueToDouble(init));
         }
+    } catch (const std::bad_alloc&) {
+        throw Error(ErrorId::OUT_OF_MEMORY);
     } catch (...) {
         throw Error(ErrorId::ILLEGAL_QUANTITY);
     }
 }
 
-BA67::Value& Basic::Array::at(const Basic::ArrayIndex& ix) {
-    if (isDictionary) {
-        throw Error(ErrorId::TYPE_MISMATCH);
+size_t Basic::Array::size() const {
+    switch (type) {
+    case ElementType::Integer: return integers.size();
+    case ElementType::String:  return strings.size();
+    default:                   return doubles.size();
     }
-    size_t i   = 0;
-    size_t blk = 1;
+}
 
-    for (size_t n = 0; n < bounds.index.size(); ++n) {
-        size_t ixn = ix.index[n];
-        if (blk == 0 && ixn > 0) {
-            throw Error(ErrorId::BAD_SUBSCRIPT);
-        } // DIM a(5): a(1,1) = 1
-        i += ixn * blk;
-        blk *= (1 + bounds.index[n]);
+void Basic::Array::set(size_t i, const Value& v) {
+    if (isDictionary) {
+        dict.valueAt(i) = v;
+        return;
     }
-    if (i < data.size()) {
-        return data[i];
+    switch (type) {
+    case ElementType::Integer: integers[i] = ValueToInt(v); break;
+    case ElementType::String:
+        if (!ValueIsString(v)) {
+            throw Error(ErrorId::TYPE_MISMATCH);
+        }
+        strings[i] = std::get<std::string>(v);
+        break;
+    default: doubles[i] = ValueToDouble(v); break;
     }
-    throw Error(ErrorId::BAD_SUBSCRIPT); // DIM a(5): a(6) = 1: REM a is defined (0..5)
 }
 
 
-Basic::Options Basic::options; // static instance
-
 inline const std::string Basic::buildVersion() { return __DATE__; }
 
 Basic::Basic(Os* os, SoundSystem* ss) {
@@ -1936,7 +2151,7 @@ Basic::Basic(Os* os, SoundSystem* ss) {
                  "REM", "RCHARDEF", "READ", "DATA", "RESTORE",
                  "END", "RUN", "DIM", "NETGET", "HELP", "INPUT", "CLR", "ON", "SCNCLR",
                  "NEW", "LIST", "MODULE", "KEY", "GETKEY", "DEF", "DELETE", "USING",
-                 "DUMP", "CMD" };
+                 "DUMP", "CMD", "ERASE", "KEYS", "MAT", "PROFILE", "WORKER" };
 
     // commands
     commands.insert({
@@ -1953,6 +2168,7 @@ Basic::Basic(Os* os, SoundSystem* ss) {
         { "SPRDEF", CMD::SPRDEF },
         { "SPRITE", CMD::SPRITE },
         { "MOVSPR", CMD::MOVSPR },
+        { "COLLISION", CMD::COLLISION },
         { "MONITOR", CMD::MONITOR },
         { "QUIT", CMD::QUIT },
         { "FIND", CMD::FIND },
@@ -1972,11 +2188,14 @@ Basic::Basic(Os* os, SoundSystem* ss) {
         { "POKE", CMD::POKE },
         { "REMODEL", CMD::REMODEL },
         { "SOUND", CMD::SOUND },
+        { "SEND", CMD::SEND },
+        { "STATS", CMD::STATS },
         { "STOP", [&](Basic* basic, const std::vector<BA67::Value>&) { throw Error(ErrorId::BREAK); } },
         { "SLOW", [&](Basic* basic, const std::vector<BA67::Value>&) { basic->moduleVariableStack.back()->second.fastMode = false; } },
         { "FAST", [&](Basic* basic, const std::vector<BA67::Value>&) { basic->moduleVariableStack.back()->second.fastMode = true; } },
-        { "TRON", [&](Basic* basic, const std::vector<BA67::Value>&) { basic->moduleVariableStack.back()->second.traceOn = true; } },
-        { "TROFF", [&](Basic* basic, const std::vector<BA67::Value>&) { basic->moduleVariableStack.back()->second.traceOn = false; } },
+        { "TRON", CMD::TRON },
+        { "TROFF", CMD::TROFF },
+        { "TRACE", CMD::TRACE },
     });
     // commands["PRINT"] = cmdPRINT;
     // // commands["INPUT"] = cmdINPUT;
@@ -2003,20 +2222,24 @@ Basic::Basic(Os* os, SoundSystem* ss) {
         { "INT", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return ValueToInt(args[0]); } },
         { "INSTR", FKT::INSTR },
         { "JOY", FKT::JOY },
+        { "BUMP", FKT::BUMP },
         { "LEFT$", FKT::LEFT$ },
         { "LCASE$", FKT::LCASE$ },
         { "UCASE$", FKT::UCASE$ },
-        { "LEN", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return (int64_t)Unicode::utf8StrLen(ValueToString(args[0])); } },
+        { "LEN", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); std::string buf; return (int64_t)Unicode::utf8StrLen(FKT::stringArgument(args[0], buf)); } },
         { "LOG", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return log(ValueToDouble(args[0])); } },
         { "MOD", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 3); auto div = ValueToInt(args[2]); if (div == 0) { throw Error(ErrorId::ILLEGAL_QUANTITY); }return ValueToInt(args[0]) % div; } },
         { "MAX", FKT::MAX },
         { "MIN", FKT::MIN },
         { "MID$", FKT::MID$ },
-        { "PEEK", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return int64_t(basic->cpu.readBankedMem(ValueToInt(args[0]))); } },
+        { "PEEK", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); basic->os->pokeKeyboardBuffer(); return int64_t(basic->cpu.readBankedMem(ValueToInt(args[0]))); } },
         { "PEN", FKT::PEN },
         { "PETSCII$", FKT::PETSCII$ },
+        { "POLL", FKT::POLL },
         { "POS", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return int64_t(basic->os->screen.getCursorPos().x); } },
         { "POSY", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value { nargs(args, 1); return int64_t(basic->os->screen.getCursorPos().y); } },
+        { "RECV", FKT::RECV },
+        { "RECV$", FKT::RECV$ },
         { "RIGHT$", FKT::RIGHT$ },
         { "RND", FKT::RND },
         { "SGN", [&](Basic* basic, const std::vector<BA67::Value>& args) -> BA67::Value {
@@ -2135,6 +2358,9 @@ void Basic::init() {
     keyShortcuts[7 - 1] = "\"LIST \"+CHR$(13)";
     keyShortcuts[9 - 1] = "\"CHDIR \"+CHR$(34)+\"CLOUD\"+CHR$(34)+CHR$(13)+\"CATALOG\"+CHR$(13)";
 
+    if (os->settings.batchMode) {
+        return; // stdout only gets the program output
+    }
     size_t centerx = (os->screen.width - 33) / 2; //   3;
     printUtf8String("\n" + std::string(centerx, ' ') + std::string(" ****   BA67 BASIC") + charLogo + " V" + version() + ("   ****\n"));
 
@@ -2429,6 +2655,7 @@ const char* Basic::tokenizeNextCommand(const char* pc, std::vector<Token>& token
             } else {
                 tokens.push_back({ TokenType::IDENTIFIER, str, std::string(str) });
             }
+            tokens.back().systemVariable = systemVariableIndex(tokens.back().str());
         } else if (*pc == ':') {
             ++pc;
             break; // end of command
@@ -2463,6 +2690,7 @@ const char* Basic::tokenizeNextCommand(const char* pc, std::vector<Token>& token
 
 // tokenize the line, creating string_views to the line's code.
 void Basic::tokenizeLine(ProgramLine& line) {
+    ++tokenizedLines;
     line.tokens.clear();
     const char* pc = line.code.c_str();
     while (*pc != '\0') {
@@ -2548,7 +2776,7 @@ BA67::Value Basic::evaluateDefFnCall(Basic::FunctionDefinition& fn, const std::v
         // GOSUB but FNEND instead of RETURN
         auto pc = mod.programCounter;
         // set PC to DEF FN code
-        executeCommands(("GOTO " + ValueToString(fn.gotoLine)).c_str());
+        doGOTO(fn.gotoLine, false, &fn.gotoSlot);
         // run
         runToEnd();
         // reset PC to FN call
@@ -2557,47 +2785,34 @@ BA67::Value Basic::evaluateDefFnCall(Basic::FunctionDefinition& fn, const std::v
         // extract variable of function name
         auto varIt   = mod.findOrCreateVariable(fn.fnName);
         Value retval = varIt->second;
-        // remove the temporary FNX variable
+        // remove the temporary FNX variable. Drop loops that still count it.
+        for (size_t n = 0; n < mod.loopStack.size(); ++n) {
+            if (mod.loopStack[n].variable == &varIt->second) {
+                mod.loopStack.resize(n);
+                break;
+            }
+        }
         mod.variables.erase(varIt);
 
         // restore argument parameters
-        for (auto& para : fn.parameters) {
-            varIt         = mod.findOrCreateVariable(para.str());
+        for (size_t i = fn.parameters.size(); i-- > 0;) {
+            varIt         = mod.findOrCreateVariable(fn.parameters[i].str());
             varIt->second = functionCallVariableStack.back();
             functionCallVariableStack.pop_back();
         }
         return retval;
     }
 
-    // inline function body
-
-    // Create a local token list with argument substitution
-    std::vector<Token> substitutedBody = fn.body;
-    // std::vector<std::string> argumentStrings; // tokens use string_view!
-    // argumentStrings.reserve(fn.parameters.size());
-
-    for (size_t i = 0; i < fn.parameters.size(); ++i) {
-        TokenType valType = TokenType::NUMBER;
-        char c            = fn.parameters[i].valuePostfix();
-        if (c == '$') {
-            valType = TokenType::STRING;
-        } else if (c == '%') {
-            valType = TokenType::INTEGER;
-        }
-
-        // replace the variable tokens with the passed arguments
-        for (auto& token : substitutedBody) {
-            if (token.type == TokenType::IDENTIFIER && token.str() == fn.parameters[i].str()) {
-                token.type = valType;
-                // argumentStrings.emplace_back(ValueToString(arguments[i * 2 /* every other arg is the comma operator*/]));
-                // token.str() = argumentStrings.back();
-                token.tv = arguments[i * 2 /* every other arg is the comma operator*/];
-            }
-        }
+    // inline function body. The PARAMETER tokens read from the argument frame.
+    fnArguments.push_back(&arguments);
+    try {
+        Value retval = evaluateExpression(fn.body, 0)[0];
+        fnArguments.pop_back();
+        return retval;
+    } catch (...) {
+        fnArguments.pop_back();
+        throw;
     }
-
-    // Evaluate the substituted expression
-    return evaluateExpression(substitutedBody, 0)[0];
 }
 
 // Evaluate expression using Shunting-Yard algorithm
@@ -2613,16 +2828,13 @@ std::vector<BA67::Value> Basic::evaluateExpression(const std::vector<Token>& tok
     std::vector<const Token*> ops;
     ops.reserve(tokens.size());
 
-    // static string pointers for string_view of unary operators
-    static std::vector<Token> unaryOperators;
-    if (unaryOperators.empty()) {
-        unaryOperators.reserve(0x100);
-        for (size_t i = 0; i < 256; ++i) {
-            unaryOperators.push_back({ TokenType::OPERATOR, "u", Operator("u") });
-        }
-        unaryOperators[size_t('-')] = { TokenType::OPERATOR, "u-", Operator("u-") };
-        unaryOperators[size_t('+')] = { TokenType::OPERATOR, "u+", Operator("u+") };
-    }
+    // static string pointers for string_view of unary operators. Built once, thread safe.
+    static const std::vector<Token> unaryOperators = [] {
+        std::vector<Token> ops(0x100, { TokenType::OPERATOR, "u", Operator("u") });
+        ops[size_t('-')] = { TokenType::OPERATOR, "u-", Operator("u-") };
+        ops[size_t('+')] = { TokenType::OPERATOR, "u+", Operator("u+") };
+        return ops;
+    }();
 
     static const std::string_view opGEQ(">=");
     static const std::string_view opLEQ("<=");
@@ -2961,11 +3173,16 @@ std::vector<BA67::Value> Basic::evaluateExpression(const std::vector<Token>& tok
             values.push_back(toki.tv);
         } else if (toki.type == TokenType::STRING) {
             values.push_back(toki.tv);
+        } else if (toki.type == TokenType::PARAMETER) {
+            if (fnArguments.empty()) {
+                throw Error(ErrorId::INTERNAL);
+            }
+            values.push_back((*fnArguments.back())[size_t(std::get<int64_t>(toki.tv)) * 2]);
         } else if (toki.type == TokenType::IDENTIFIER) {
             // TODO A(5)=10 will automatically DIM A(10) in CBM BASIC.
             // function or array
             size_t end  = i;
-            Value* pval = findLeftValue(currentModule(), tokens, i, &end);
+            ValueRef pval = findLeftValue(currentModule(), tokens, i, &end);
             if (pval != nullptr) {
                 values.push_back(*pval);
                 if (end > i) {
@@ -2994,13 +3211,19 @@ std::vector<BA67::Value> Basic::evaluateExpression(const std::vector<Token>& tok
                 auto fktit = functions.find(toki.str());
                 if (fktit != functions.end()) {
                     // function(args)
+                    if (profiler.on) {
+                        uint64_t start = Profiler::now();
+                        values.push_back(fktit->second(this, args));
+                        profiler.addFunction(toki.str(), Profiler::now() - start);
+                        continue;
+                    }
                     auto retval = fktit->second(this, args); // call function
                     values.push_back(retval);
                     continue;
                 }
 
                 // See if it's a DEF FN
-                static std::string strFN("FN");
+                static const std::string strFN("FN");
                 std::string fname;
                 if (prevToki.type == TokenType::KEYWORD && prevToki.str() == "FN") {
                     fname = strFN + toki.str();
@@ -3022,7 +3245,7 @@ std::vector<BA67::Value> Basic::evaluateExpression(const std::vector<Token>& tok
             }
             ++i;
             size_t end  = i;
-            Value* pval = findLeftValue(modit->second, tokens, i, &end);
+            ValueRef pval = findLeftValue(modit->second, tokens, i, &end);
             if (pval != nullptr) {
                 values.push_back(*pval);
                 if (end > i) {
@@ -3172,7 +3395,7 @@ inline void Basic::handleLET(const std::vector<Token>& tokens) {
     size_t ivarname = i;
     size_t end      = i;
 
-    Value* pval = nullptr;
+    ValueRef pval = nullptr;
     if (tokens[i].type == TokenType::MODULE) {
         auto modit = modules.find(tokens[i].str());
         if (modit == modules.end()) {
@@ -3210,17 +3433,15 @@ inline void Basic::handleLET(const std::vector<Token>& tokens) {
         throw Error(ErrorId::SYNTAX);
     }
 
-    static const std::string_view varTI("TI$");
-    if (tokens[ivarname].is(varTI)) {
-        std::string ti$ = ValueToString(*pval);
-        if (ti$.length() != 6) {
-            throw Error(ErrorId::ILLEGAL_QUANTITY);
-        }
-        int64_t secs   = ((ti$[5] - '0') + (ti$[4] - '0') * 10) % 60;
-        int64_t mins   = ((ti$[3] - '0') + (ti$[2] - '0') * 10) % 60;
-        int64_t hours  = ((ti$[1] - '0') + (ti$[0] - '0') * 10) % 24;
-        int64_t tiTick = secs * 1000 + mins * 60000 + hours * 60 * 60000;
-        time0          = os->tick() - tiTick;
+    const Token& varname = tokens[ivarname];
+    if (varname.type == TokenType::IDENTIFIER && varname.systemVariable >= 0 && systemVariables[varname.systemVariable].set != nullptr) {
+        systemVariables[varname.systemVariable].set(this, *pval);
+    }
+
+    auto& listingModule = moduleListingStack.back()->second;
+    if (traceRing.variables && listingModule.traceOn) {
+        auto& pc = listingModule.programCounter;
+        traceRing.assign(pc.line != listingModule.listing.end() ? pc.line->first : -1, &listingModule, varname.str(), pval.get());
     }
 }
 
@@ -3311,7 +3532,15 @@ void Basic::doPrintValue(Value& v) {
         if (ValueIsString(v)) {
             printUtf8String(BA67::ValueToString(v), true /* apply control characters */, true /*even in quotes*/);
         } else {
-            printUtf8String((" " + BA67::ValueToString(v) + " "));
+            char buf[BA67::NumberTextSize + 2] = { ' ' };
+            size_t len                         = 1;
+            if (auto i = std::get_if<int64_t>(&v)) {
+                len += BA67::NumberToChars(*i, buf + 1);
+            } else {
+                len += BA67::NumberToChars(BA67::ValueToDouble(v), buf + 1);
+            }
+            buf[len++] = ' ';
+            printUtf8String(std::string_view(buf, len));
         }
     }
 }
@@ -3552,7 +3781,7 @@ void Basic::handleGET(const std::vector<Token>& tokens, bool waitForKeypress) {
     for (size_t itk = istart; itk < tokens.size(); ++itk) {
         auto& tk = tokens[itk];
         if (tk.type != TokenType::COMMA) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -3683,7 +3912,7 @@ void Basic::handleINPUTFile(const std::vector<Token>& tokens) {
     for (size_t itk = istart; itk < tokens.size(); ++itk) {
         auto& tk = tokens[itk];
         if (tk.type != TokenType::COMMA && tk.type != TokenType::OPERATOR) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -3757,7 +3986,7 @@ void Basic::handleINPUT(const std::vector<Token>& tokens) {
                 printUtf8String("\n");
             }
         } else if (tk.type != TokenType::COMMA && tk.type != TokenType::OPERATOR) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -3793,7 +4022,7 @@ void Basic::handleINPUT(const std::vector<Token>& tokens) {
                     }
                     badinput = false;
                 } catch (const Error& e) {
-                    if (e.ID == ErrorId::BREAK) {
+                    if (e.ID == ErrorId::BREAK || e.ID == ErrorId::OUT_OF_DATA /* end of the --batch input */) {
                         throw e;
                     }
 
@@ -3824,7 +4053,7 @@ void Basic::handleNETGET(const std::vector<Token>& tokens) {
     for (size_t itk = starttok; itk < tokens.size(); ++itk) {
         auto& tk = tokens[itk];
         if (tk.type != TokenType::COMMA) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -3864,7 +4093,7 @@ inline void Basic::handleDIM(const std::vector<Token>& tokens) {
         varnamePostfix = tokens[i].valuePostfix();
         ++i;
         if (i >= tokens.size() || tokens[i].type != TokenType::PARENTHESIS || !tokens[i].is('(')) {
-            Value* value = findLeftValue(currentModule(), tokens, i - 1, &i);
+            ValueRef value = findLeftValue(currentModule(), tokens, i - 1, &i);
             if (value == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -3912,8 +4141,295 @@ inline void Basic::handleDIM(const std::vector<Token>& tokens) {
     }
 }
 
+// MAT a = b + c, b - c, b * c, (k) * b, (k), b, TRN(b), IDN, ZER, CON
+// MAT s = SUM(a), DOT(a, b)
+// Whole array math on numeric arrays. See mat_kernels.h.
+// A% arrays use integer math. All arrays of one statement have the same type.
+void Basic::handleMAT(const std::vector<Token>& tokens) {
+    auto& arrays = currentModule().arrays;
+
+    auto isWord = [&](size_t k, const char* word) {
+        return k < tokens.size() && tokens[k].type == TokenType::IDENTIFIER && tokens[k].is(word);
+    };
+    auto isChar = [&](size_t k, char c) { return k < tokens.size() && tokens[k].is(c); };
+    // array name with optional ()
+    auto parseArrayName = [&](size_t& k) -> const std::string& {
+        if (k >= tokens.size() || tokens[k].type != TokenType::IDENTIFIER) {
+            throw Error(ErrorId::SYNTAX);
+        }
+        const std::string& name = tokens[k++].str();
+        if (isChar(k, '(') && isChar(k + 1, ')')) {
+            k += 2;
+        }
+        return name;
+    };
+    auto expectEnd = [&](size_t k) {
+        if (k != tokens.size()) {
+            throw Error(ErrorId::SYNTAX);
+        }
+    };
+    // matrix operations only work on a(rows-1) and a(rows-1, cols-1)
+    auto rowsOf = [](const Array& a) { return a.bounds.index[0] + 1; };
+    auto colsOf = [](const Array& a) {
+        if (a.bounds.index[2] != 0 || a.bounds.index[3] != 0) {
+            throw Error(ErrorId::BAD_SUBSCRIPT);
+        }
+        return a.bounds.index[1] + 1;
+    };
+
+    size_t i                   = 1;
+    const std::string& dstName = parseArrayName(i);
+    if (!isChar(i, '=')) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    ++i;
+
+    // SUM and DOT work in the type of their array, everything else in the type of the target
+    bool isReduction = (isWord(i, "SUM") || isWord(i, "DOT")) && isChar(i + 1, '(');
+    bool integers    = tokens[1].valuePostfix() == '%';
+    if (isReduction) {
+        size_t k = i + 2;
+        auto it  = arrays.find(parseArrayName(k));
+        integers = it != arrays.end() && it->second.type == Array::ElementType::Integer;
+    } else if (tokens[1].valuePostfix() == '$') {
+        throw Error(ErrorId::TYPE_MISMATCH);
+    }
+
+    // T is double or int64_t, zero tells which
+    auto matOps = [&](auto zero) {
+        using T                     = decltype(zero);
+        const Array::ElementType et = std::is_same_v<T, int64_t> ? Array::ElementType::Integer : Array::ElementType::Double;
+        auto elements               = [](auto& a) -> auto& {
+            if constexpr (std::is_same_v<T, int64_t>) {
+                return a.integers;
+            } else {
+                return a.doubles;
+            }
+        };
+        auto numericArray = [&](const std::string& name) -> Array& {
+            auto it = arrays.find(name);
+            if (it == arrays.end()) {
+                throw Error(ErrorId::VARIABLE_UNDEFINED);
+            }
+            if (it->second.isDictionary || it->second.type != et) {
+                throw Error(ErrorId::TYPE_MISMATCH);
+            }
+            return it->second;
+        };
+        // the target is re-dimensioned if it does not match the result
+        auto target = [&](const ArrayIndex& bounds) -> Array& {
+            auto& dst = arrays[dstName];
+            if (dst.isDictionary || dst.type != et || dst.bounds.index != bounds.index || elements(dst).empty()) {
+                dst.dim(zero, bounds);
+            }
+            return dst;
+        };
+
+        // MAT s = SUM(a), MAT s = DOT(a, b)
+        if (isReduction) {
+            bool isDot = tokens[i].is("DOT");
+            size_t k   = i + 2;
+            Array& a   = numericArray(parseArrayName(k));
+            T s        = zero;
+            if (isDot) {
+                if (k >= tokens.size() || tokens[k].type != TokenType::COMMA) {
+                    throw Error(ErrorId::SYNTAX);
+                }
+                ++k;
+                Array& b = numericArray(parseArrayName(k));
+                if (elements(a).size() != elements(b).size()) {
+                    throw Error(ErrorId::BAD_SUBSCRIPT);
+                }
+                s = MatKernels::dot(elements(a).data(), elements(b).data(), elements(a).size());
+            } else {
+                s = MatKernels::sum(elements(a).data(), elements(a).size());
+            }
+            if (!isChar(k, ')')) {
+                throw Error(ErrorId::SYNTAX);
+            }
+            expectEnd(k + 1);
+
+            Value& var = currentModule().findOrCreateVariable(dstName)->second;
+            switch (tokens[1].valuePostfix()) {
+            case '$': throw Error(ErrorId::TYPE_MISMATCH);
+            case '%': var = ValueToInt(Value(s)); break;
+            default:  var = double(s); break;
+            }
+            return;
+        }
+
+        // MAT a = IDN, ZER, CON [(rows [, cols])]
+        if (isWord(i, "IDN") || isWord(i, "ZER") || isWord(i, "CON")) {
+            const Token& fkt = tokens[i];
+            Array* dst       = nullptr;
+            if (isChar(i + 1, '(')) {
+                size_t end = i + 2;
+                auto vals  = evaluateExpression(tokens, i + 2, &end);
+                if (!isChar(end, ')')) {
+                    throw Error(ErrorId::SYNTAX);
+                }
+                expectEnd(end + 1);
+                dst = &arrays[dstName];
+                dst->dim(zero, indexFromValues(vals));
+            } else {
+                expectEnd(i + 1);
+                dst = &numericArray(dstName);
+            }
+
+            if (fkt.is("IDN")) {
+                MatKernels::identity(elements(*dst).data(), rowsOf(*dst), colsOf(*dst));
+            } else {
+                MatKernels::fill(elements(*dst).data(), elements(*dst).size(), T(fkt.is("CON") ? 1 : 0));
+            }
+            return;
+        }
+
+        // MAT a = TRN(b)
+        if (isWord(i, "TRN") && isChar(i + 1, '(')) {
+            size_t k       = i + 2;
+            const Array& a = numericArray(parseArrayName(k));
+            if (!isChar(k, ')')) {
+                throw Error(ErrorId::SYNTAX);
+            }
+            expectEnd(k + 1);
+
+            size_t rows = rowsOf(a), cols = colsOf(a);
+            std::vector<T> result(elements(a).size());
+            MatKernels::transpose(result.data(), elements(a).data(), rows, cols);
+            elements(target(ArrayIndex(cols - 1, rows - 1))).swap(result);
+            return;
+        }
+
+        // MAT a = (k) fills, MAT a = (k) * b scales. k is made an integer for A%
+        if (isChar(i, '(')) {
+            size_t end = i + 1;
+            auto vals  = evaluateExpression(tokens, i + 1, &end);
+            if (vals.size() != 1 || !isChar(end, ')') || ValueIsString(vals[0])) {
+                throw Error(ErrorId::SYNTAX);
+            }
+            T factor = zero;
+            if constexpr (std::is_same_v<T, int64_t>) {
+                factor = ValueToInt(vals[0]);
+            } else {
+                factor = ValueToDouble(vals[0]);
+            }
+            size_t k = end + 1;
+            if (k == tokens.size()) {
+                Array& dst = numericArray(dstName);
+                MatKernels::fill(elements(dst).data(), elements(dst).size(), factor);
+                return;
+            }
+            if (!isChar(k, '*')) {
+                throw Error(ErrorId::SYNTAX);
+            }
+            ++k;
+            const Array& a = numericArray(parseArrayName(k));
+            expectEnd(k);
+            Array& dst = target(a.bounds);
+            MatKernels::scale(elements(dst).data(), elements(a).data(), factor, elements(a).size());
+            return;
+        }
+
+        // MAT a = b, MAT a = b + c, b - c, b * c
+        const Array& a = numericArray(parseArrayName(i));
+        if (i == tokens.size()) {
+            Array& dst = target(a.bounds);
+            MatKernels::copy(elements(dst).data(), elements(a).data(), elements(a).size());
+            return;
+        }
+        const Token& op = tokens[i++];
+        const Array& b  = numericArray(parseArrayName(i));
+        expectEnd(i);
+
+        if (op.is('*')) {
+            size_t rows = rowsOf(a), inner = colsOf(a), cols = colsOf(b);
+            if (rowsOf(b) != inner) {
+                throw Error(ErrorId::BAD_SUBSCRIPT);
+            }
+            std::vector<T> result(rows * cols);
+            MatKernels::multiply(result.data(), elements(a).data(), elements(b).data(), rows, inner, cols);
+            elements(target(ArrayIndex(rows - 1, cols - 1))).swap(result);
+            return;
+        }
+        if (!op.is('+') && !op.is('-')) {
+            throw Error(ErrorId::SYNTAX);
+        }
+        if (a.bounds.index != b.bounds.index) {
+            throw Error(ErrorId::BAD_SUBSCRIPT);
+        }
+        Array& dst = target(a.bounds);
+        if (op.is('+')) {
+            MatKernels::add(elements(dst).data(), elements(a).data(), elements(b).data(), elements(a).size());
+        } else {
+            MatKernels::subtract(elements(dst).data(), elements(a).data(), elements(b).data(), elements(a).size());
+        }
+    };
+
+    if (integers) {
+        matOps(int64_t(0));
+    } else {
+        matOps(0.0);
+    }
+}
+
+// ERASE a$(key) removes a key from a dictionary. ERASE a$() removes all keys.
+void Basic::handleERASE(const std::vector<Token>& tokens) {
+    if (tokens.size() < 4 || tokens[1].type != TokenType::IDENTIFIER || !tokens[2].is('(')) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    auto& arrays = currentModule().arrays;
+    auto arrit   = arrays.find(tokens[1].str());
+    if (arrit == arrays.end() || !arrit->second.isDictionary) {
+        throw Error(ErrorId::TYPE_MISMATCH);
+    }
+
+    size_t end = 3;
+    auto args  = evaluateExpression(tokens, 3, &end);
+    if (end + 1 != tokens.size() || !tokens[end].is(')')) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    if (args.empty()) {
+        arrit->second.dict.clear();
+    } else if (args.size() == 1) {
+        arrit->second.dict.erase(args[0]);
+    } else {
+        throw Error(ErrorId::BAD_SUBSCRIPT);
+    }
+}
+
+// KEYS a$(), k$() dims k$ with the keys of the dictionary a$ in insertion order
+void Basic::handleKEYS(const std::vector<Token>& tokens) {
+    if (tokens.size() != 8
+        || tokens[1].type != TokenType::IDENTIFIER || !tokens[2].is('(') || !tokens[3].is(')')
+        || tokens[4].type != TokenType::COMMA
+        || tokens[5].type != TokenType::IDENTIFIER || !tokens[6].is('(') || !tokens[7].is(')')) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    auto& arrays = currentModule().arrays;
+    auto arrit   = arrays.find(tokens[1].str());
+    if (arrit == arrays.end() || !arrit->second.isDictionary) {
+        throw Error(ErrorId::TYPE_MISMATCH);
+    }
+    auto keys = arrit->second.dict.keys();
+
+    Value init;
+    switch (tokens[5].valuePostfix()) {
+    case '%': init = int64_t(0); break;
+    case '$': init = std::string(); break;
+    default:  init = 0.0; break;
+    }
+    auto& dst = arrays[tokens[5].str()];
+    dst.dim(init, ArrayIndex(keys.empty() ? 0 : keys.size() - 1));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (ValueIsString(init)) {
+            dst.set(i, ValueToString(keys[i]));
+        } else {
+            dst.set(i, keys[i]);
+        }
+    }
+}
+
 void Basic::handleLIST(const std::vector<Token>& tokens) {
-    static int lastFrom = 0, lastTo = 0x7fffffff;
     int from = 0;
     int to   = 0x7ffffff;
 
@@ -3961,14 +4477,14 @@ void Basic::handleLIST(const std::vector<Token>& tokens) {
         from = int(ValueToInt(tokens[1].tv));
     } else if (tokens.size() == 2 && tokens[1].type == TokenType::OPERATOR) {
         // LIST -
-        from = lastFrom;
-        to   = lastTo;
+        from = listLastFrom;
+        to   = listLastTo;
     } else {
         throw BA67::Error(ErrorId::ARGUMENT_COUNT);
     }
 
-    lastFrom = from;
-    lastTo   = to;
+    listLastFrom = from;
+    listLastTo   = to;
 
     std::string sline;
 
@@ -4131,8 +4647,11 @@ void Basic::handleDUMP(const std::vector<Token>& tokens) {
 
         if (arr.isDictionary) {
             int count = 0;
-            for (auto& p : arr.dict) {
-                oss << v.first << "(" << ValueToString(p.first) << ") = " << ValueToString(p.second) << std::endl;
+            for (auto& p : arr.dict.entries()) {
+                if (!p.alive) {
+                    continue;
+                }
+                oss << v.first << "(" << ValueToString(p.key) << ") = " << ValueToString(p.value) << std::endl;
                 if (++count > 9) {
                     oss << "..." << std::endl;
                     break;
@@ -4199,21 +4718,142 @@ void Basic::handleKEY(const std::vector<Token>& tokens) {
     }
 }
 
-void Basic::handleRCHARDEF(const std::vector<Token>& tokens) {
-    int iarg = 0; // nth argument to assign
+// PROFILE ON      - clear and start
+// PROFILE OFF     - stop
+// PROFILE         - print the slowest lines, keywords and functions
+// PROFILE SAVE "x" - write the collapsed call stacks for flamegraph.pl
+void Basic::handlePROFILE(const std::vector<Token>& tokens) {
+    if (tokens.size() == 1) {
+        std::string text = profiler.report(10);
+        if (text.empty()) {
+            text = "NO PROFILE DATA\n";
+        }
+        os->screen.cleanCurrentLine();
+        printUtf8String(text);
+        return;
+    }
+    if (tokens[1].is("ON") && tokens.size() == 2) {
+        profiler.clear();
+        profiler.on = true;
+    } else if (tokens[1].is("OFF") && tokens.size() == 2) {
+        profiler.on = false;
+    } else if (tokens[1].is("SAVE")) {
+        auto values = evaluateExpression(tokens, 2);
+        if (values.size() != 1) {
+            throw Error(ErrorId::ARGUMENT_COUNT);
+        }
+        std::string stacks = profiler.collapsedStacks();
 
-    // i_arg         0        1   2
-    // RCHARDEF i_char, is_mono, b1, b2, b3, b4, b5, b6, b7, b8
+        FilePtr file(os);
+        file.open(ValueToString(values[0]), "wb");
+        if (!file) {
+            throw Error(ErrorId::ILLEGAL_DEVICE);
+        }
+        file.write(stacks.data(), stacks.size());
+    } else {
+        throw Error(ErrorId::SYNTAX);
+    }
+}
 
-    CharBitmap bmp;
-    for (size_t itk = 1; itk < tokens.size(); ++itk) {
-        auto& tk = tokens[itk];
-        if (itk == 1) {
+// WORKER                                 - list the workers
+// WORKER name$ [, capacity [, module$]]  - run a copy of the module on a thread of its own
+// WORKER name$ OFF, WORKER OFF           - BREAK and remove one or all workers
+void Basic::handleWORKER(const std::vector<Token>& tokens) {
+    if (tokens.size() == 1) {
+        std::string text;
+        for (auto& w : workers) {
+            text += w.first + " " + w.second->status()
+                  + ", RECV " + ValueToString(int64_t(w.second->toParent.size())) // what POLL counts
+                  + ", QUEUED " + ValueToString(int64_t(w.second->toWorker.size())) + "\n";
+        }
+        if (text.empty()) {
+            text = "NO WORKERS\n";
+        }
+        os->screen.cleanCurrentLine();
+        printUtf8String(text);
+        return;
+    }
+    if (tokens.size() == 2 && tokens[1].is("OFF")) {
+        workers.clear();
+        return;
+    }
+
+    bool off = tokens.back().is("OFF");
+    std::vector<Token> expression(tokens.begin(), off ? tokens.end() - 1 : tokens.end());
+    auto values = evaluateExpression(expression, 1);
+    if (values.empty() || values.size() > (off ? 1 : 5)) {
+        throw Error(ErrorId::ARGUMENT_COUNT);
+    }
+    if (!ValueIsString(values[0])) {
+        throw Error(ErrorId::TYPE_MISMATCH);
+    }
+    std::string name = ValueToString(values[0]);
+    Unicode::toUpper(name);
+    if (off) {
+        if (workers.erase(name) == 0) {
+            throw Error(ErrorId::UNDEFD_MODULE);
+        }
+        return;
+    }
+
+    int64_t capacity = values.size() >= 3 ? ValueToInt(values[2]) : 64;
+    if (capacity < 1) {
+        throw Error(ErrorId::ILLEGAL_QUANTITY);
+    }
+    std::string moduleName = name;
+    if (values.size() == 5) {
+        moduleName = ValueToString(values[4]);
+        Unicode::toUpper(moduleName);
+    }
+    auto module = modules.find(moduleName);
+    if (module == modules.end() || module->second.listing.lower_bound(0) == module->second.listing.end()) {
+        throw Error(ErrorId::UNDEFD_MODULE);
+    }
+    workers.erase(name); // a restart
+    if (workers.size() >= os->settings.maxWorkers) {
+        throw Error(os->settings.maxWorkers == 0 ? ErrorId::UNIMPLEMENTED_COMMAND : ErrorId::OUT_OF_MEMORY);
+    }
+    workers[name] = std::make_unique<ModuleWorker>(*this, name, moduleName, size_t(capacity));
+}
+
+void Basic::channelsOf(const std::string& name, Channel*& in, Channel*& out) {
+    std::string upper = name;
+    Unicode::toUpper(upper);
+    if (upper == "PARENT" && asWorker != nullptr) {
+        in  = &asWorker->toWorker;
+        out = &asWorker->toParent;
+        return;
+    }
+    auto it = workers.find(upper);
+    if (it == workers.end()) {
+        throw Error(ErrorId::UNDEFD_MODULE);
+    }
+    in  = &it->second->toParent;
+    out = &it->second->toWorker;
+}
+
+void Basic::waitForChannel(Channel& channel) {
+    handleEscapeKey();
+    os->updateEvents();
+    os->presentScreen();
+    channel.wait(10);
+}
+
+void Basic::handleRCHARDEF(const std::vector<Token>& tokens) {
+    int iarg = 0; // nth argument to assign
+
+    // i_arg         0        1   2
+    // RCHARDEF i_char, is_mono, b1, b2, b3, b4, b5, b6, b7, b8
+
+    CharBitmap bmp;
+    for (size_t itk = 1; itk < tokens.size(); ++itk) {
+        auto& tk = tokens[itk];
+        if (itk == 1) {
             std::string str;
             if (tk.type == TokenType::STRING) {
                 str = tk.str();
             } else if (tk.type == TokenType::IDENTIFIER) {
-                Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+                ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
                 if (pval != nullptr) {
                     str = ValueToString(*pval);
                 } else {
@@ -4240,7 +4880,7 @@ void Basic::handleRCHARDEF(const std::vector<Token>& tokens) {
             throw Error(ErrorId::ARGUMENT_COUNT);
         }
         if (tk.type != TokenType::COMMA) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -4279,9 +4919,56 @@ void Basic::handleRCHARDEF(const std::vector<Token>& tokens) {
 }
 
 
+// TI is the time in jiffies (1/60th seconds), TI$ is "hhmmss".
+// Both are relative to time0, which an assignment to TI$ moves.
+const Basic::SystemVariable Basic::systemVariables[] = {
+    { "TI",
+     [](Basic* basic) -> Value {
+         int64_t ti_ms = int64_t(basic->os->tick() - basic->time0);
+         return int64_t(ti_ms * 60LL / 1000LL);
+     }, nullptr },
+    { "TI$",
+     [](Basic* basic) -> Value {
+         int64_t secs  = int64_t(basic->os->tick() - basic->time0) / 1000;
+         int64_t mins  = secs / 60;
+         int64_t hours = (mins / 60) % 24;
+         secs %= 60;
+         mins %= 60;
+         char buf[7] = { char('0' + hours / 10), char('0' + hours % 10), char('0' + mins / 10),
+                         char('0' + mins % 10), char('0' + secs / 10), char('0' + secs % 10), '\0' };
+         return std::string(buf, 6);
+     },
+     [](Basic* basic, const Value& value) {
+         std::string ti$ = ValueToString(value);
+         if (ti$.length() != 6) {
+             throw Error(ErrorId::ILLEGAL_QUANTITY);
+         }
+         int64_t secs   = ((ti$[5] - '0') + (ti$[4] - '0') * 10) % 60;
+         int64_t mins   = ((ti$[3] - '0') + (ti$[2] - '0') * 10) % 60;
+         int64_t hours  = ((ti$[1] - '0') + (ti$[0] - '0') * 10) % 24;
+         int64_t tiTick = secs * 1000 + mins * 60000 + hours * 60 * 60000;
+         basic->time0   = basic->os->tick() - tiTick;
+     }                                  },
+    { "ST",     [](Basic* basic) -> Value { return int64_t(basic->cpu.RAM[krnl.STATUS]); }, nullptr },
+    { "STATUS", [](Basic* basic) -> Value { return int64_t(basic->cpu.RAM[krnl.STATUS]); }, nullptr },
+};
+
+int32_t Basic::systemVariableIndex(std::string_view name) {
+    // all names are 2..6 characters and start with S or T
+    if (name.length() < 2 || name.length() > 6 || (name[0] != 'T' && name[0] != 'S')) {
+        return -1;
+    }
+    for (int32_t i = 0; i < int32_t(std::size(systemVariables)); ++i) {
+        if (systemVariables[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 // put endPtr to the next token to process
 // returns nullptr on error
-BA67::Value* Basic::findLeftValue(Module& module, const std::vector<Token>& tokens, size_t start, size_t* endPtr, bool allowDimArray) {
+Basic::ValueRef Basic::findLeftValue(Module& module, const std::vector<Token>& tokens, size_t start, size_t* endPtr, bool allowDimArray) {
     size_t i = start;
     if (tokens.size() > i + 2 && tokens[i + 1].type == TokenType::PARENTHESIS && tokens[i + 1].is('(')) {
         auto& arrays = module.arrays;
@@ -4312,14 +4999,18 @@ BA67::Value* Basic::findLeftValue(Module& module, const std::vector<Token>& toke
             auto& arr = arrit->second;
 
             if (arr.isDictionary) {
+                if (args.empty()) { // A$() is the number of keys
+                    dictionarySizeVariable = int64_t(arr.dict.size());
+                    return ValueRef::readOnly(&dictionarySizeVariable);
+                }
                 if (args.size() != 1) {
                     throw Error(ErrorId::BAD_SUBSCRIPT);
                 }
-                return &arr.atKey(args[0]);
+                return ValueRef(&arr, arr.indexOfKey(args[0]));
             } else {
                 // array(index)
                 auto arridx = this->indexFromValues(args);
-                return &arr.at(arridx);
+                return ValueRef(&arr, arr.indexOf(arridx));
             }
         } else {
             return nullptr;
@@ -4332,56 +5023,24 @@ BA67::Value* Basic::findLeftValue(Module& module, const std::vector<Token>& toke
             *endPtr = 1 + start;
         }
 
-        const std::string& variableName = tokens[i].str();
-        static const std::string_view svTI("TI");
-        static const std::string_view svTI$("TI$");
-        static const std::string_view svST("ST");
-        static const std::string_view svSTATUS("STATUS");
-        if (variableName == svTI || variableName == svTI$) { //  TI or TI$
-            int64_t ti_ms = os->tick() - time0;
-            int64_t ti    = int64_t((ti_ms) * 60LL) / 1000LL; // jiffies
-            TIvariable    = BA67::Value(ti);
-
-            if (variableName == svTI$) {
-                int64_t secs  = ti_ms / 1000;
-                int64_t mins  = secs / 60;
-                int64_t hours = mins / 60;
-
-                secs %= 60;
-                mins %= 60;
-                hours %= 24;
-
-                auto str2 = [](int64_t i) -> std::string {
-                    static const char* nums = "0123456789";
-                    char buf[3]             = { nums[(i / 10) % 10], nums[i % 10], '\0' };
-                    return { buf };
-                };
-                TI$variable = str2(hours) + str2(mins) + str2(secs);
-                return &TI$variable;
-            }
-            // #error not working ti$="000100":?ti$
-
-            return &TIvariable; // jiffies (1/60th seconds)
-        } else if (variableName == svST || variableName == svSTATUS) {
-            STvariable = int64_t(cpu.RAM[krnl.STATUS]);
-            return &STvariable;
+        if (tokens[i].systemVariable >= 0) { // TI, ST,... flagged by the tokenizer
+            systemVariableValue = systemVariables[tokens[i].systemVariable].get(this);
+            return &systemVariableValue;
         }
 
-        auto varit = module.findOrCreateVariable(variableName);
+        auto varit = module.findOrCreateVariable(tokens[i].str());
         return &varit->second;
     }
 
     return nullptr;
 }
 
-void Basic::doGOTO(int line, bool isGoSub) {
+void Basic::doGOTO(int line, bool isGoSub, int32_t* slotCache) {
 
 
 #ifdef __EMSCRIPTEN__
-    static int gotocount = 0;
-    ++gotocount;
-    if (gotocount > 100) {
-        gotocount = 0;
+    if (++gotoCount > 100) {
+        gotoCount = 0;
         os->delay(1); // experienced crashes otherwise due to asyncify, I guess
     }
 #endif
@@ -4401,21 +5060,30 @@ void Basic::doGOTO(int line, bool isGoSub) {
 
     if (isGoSub) {
         LoopItem loop;
-        loop.varName = "GOSUB";
-        loop.jump    = programCounter();
+        loop.type = LoopItem::GOSUB;
+        loop.jump = programCounter();
         currentModule().loopStack.push_back(loop);
     }
     // TODO make sure you're in the module code now
-    auto& listing = currentListing();
-    auto it       = listing.find(line);
-    if (it == listing.end()) {
+    auto& mod = moduleListingStack.back()->second;
+    auto it   = mod.findLine(line, slotCache);
+    if (it == mod.listing.end()) {
         throw Error(ErrorId::UNDEFD_STATEMENT);
     }
     programCounter().line   = it;
     programCounter().cmdpos = 0;
 }
 
+// GOTO 100 - literal line numbers remember their target in the token
+static bool isLiteralLine(const Token& t) {
+    return t.type == TokenType::INTEGER || t.type == TokenType::NUMBER;
+}
+
 void Basic::handleGOTO(const std::vector<Token>& tokens) {
+    if (tokens.size() == 2 && isLiteralLine(tokens[1])) {
+        doGOTO(int(ValueToInt(tokens[1].tv)), false, &tokens[1].lineSlot);
+        return;
+    }
     auto values = evaluateExpression(tokens, 1);
     if (values.size() == 0 || values.size() > 2) {
         throw Error(ErrorId::SYNTAX);
@@ -4426,6 +5094,10 @@ void Basic::handleGOTO(const std::vector<Token>& tokens) {
 }
 
 void Basic::handleGOSUB(const std::vector<Token>& tokens) {
+    if (tokens.size() == 2 && isLiteralLine(tokens[1])) {
+        doGOTO(int(ValueToInt(tokens[1].tv)), true, &tokens[1].lineSlot);
+        return;
+    }
     auto values = evaluateExpression(tokens, 1);
     if (values.size() == 0 || values.size() > 2) {
         throw Error(ErrorId::SYNTAX);
@@ -4440,22 +5112,43 @@ void Basic::handleONGOTO(const std::vector<Token>& tokens) {
     size_t i   = 1;
     int64_t on = ValueToInt(evaluateExpression(tokens, i, &i)[0]);
 
-    auto lines = evaluateExpression(tokens, i + 1);
+    static const std::string_view cmdGOTO("GOTO");
+    static const std::string_view cmdGOSUB("GOSUB");
+    if (i >= tokens.size() || tokens[i].type != TokenType::KEYWORD) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    bool isGoSub = tokens[i].is(cmdGOSUB);
+    if (!isGoSub && !tokens[i].is(cmdGOTO)) {
+        throw Error(ErrorId::SYNTAX);
+    }
 
     // fall through when index was not given
-    int64_t index = (on - 1) * 2;
-    if (index < 1 || index >= int64_t(lines.size())) {
+    if (on < 1) {
         return;
     }
-    static const std::string_view cmdGOTO("GOTO");
-    static const std::string_view cmdGOSUB("GOSUB");
-    if (tokens[i].is(cmdGOTO)) {
-        doGOTO(int(ValueToInt(lines[index])), false); // 1=[0], 2=[2], 3=[4]
-    } else if (tokens[i].is(cmdGOSUB)) {
-        doGOTO(int(ValueToInt(lines[index])), true); // 1=[0], 2=[2], 3=[4]
-    } else {
-        throw Error(ErrorId::SYNTAX);
+
+    // literal line numbers: pick the target token directly, line1 is at [i+1], line2 at [i+3]
+    bool allLiteral = true;
+    for (size_t k = i + 1; k < tokens.size(); k += 2) {
+        if (!isLiteralLine(tokens[k]) || (k + 1 < tokens.size() && tokens[k + 1].type != TokenType::COMMA)) {
+            allLiteral = false;
+            break;
+        }
     }
+    if (allLiteral) {
+        size_t k = i + 1 + size_t(on - 1) * 2;
+        if (k < tokens.size()) {
+            doGOTO(int(ValueToInt(tokens[k].tv)), isGoSub, &tokens[k].lineSlot);
+        }
+        return;
+    }
+
+    auto lines    = evaluateExpression(tokens, i + 1);
+    int64_t index = (on - 1) * 2; // 1=[0], 2=[2], 3=[4]
+    if (index >= int64_t(lines.size())) {
+        return;
+    }
+    doGOTO(int(ValueToInt(lines[index])), isGoSub);
 }
 
 void Basic::handleHELP(const std::vector<Token>& tokens) {
@@ -4572,6 +5265,21 @@ void Basic::handleDEFFN(const std::vector<Token>& intokens) {
                     throw Error(ErrorId::SYNTAX);
                 }
 
+                // compile the parameter names to argument slots. FN X(...) is a call, not X.
+                for (size_t k = 0; k < def.body.size(); ++k) {
+                    auto& token = def.body[k];
+                    if (token.type != TokenType::IDENTIFIER || (k > 0 && def.body[k - 1].is(cmdFN))) {
+                        continue;
+                    }
+                    for (size_t p = 0; p < def.parameters.size(); ++p) {
+                        if (token.str() == def.parameters[p].str()) {
+                            token.type = TokenType::PARAMETER;
+                            token.tv   = int64_t(p);
+                            break;
+                        }
+                    }
+                }
+
             } else {
                 // no equals (=) after closing brace
                 // BA67 allows Dartmouth BASIC's multiline DEF FN
@@ -4608,52 +5316,62 @@ void Basic::handleFOR(const std::vector<Token>& tokens) {
     if (tokens.size() < 6 || !tokens[2].is('=')) {
         return;
     }
-    const std::string& varName(tokens[1].str());
-    auto values = evaluateExpression(tokens, 3);
-    if (values.size() != 1) {
+    static const std::string_view cmdTO("TO");
+    static const std::string_view cmdSTEP("STEP");
+
+    // FOR var = start TO end [STEP step]
+    size_t i    = 3;
+    auto values = evaluateExpression(tokens, i, &i);
+    if (values.size() != 1 || i >= tokens.size() || !tokens[i].is(cmdTO)) {
         throw Error(ErrorId::SYNTAX);
     }
-    double start = ValueToDouble(values.back());
+    Value start = values.back();
 
-    auto& modl = currentModule();
-
-    modl.variables[varName] = values.back();
+    values = evaluateExpression(tokens, i + 1, &i);
+    if (values.size() != 1) {
+        throw Error(ErrorId::SYNTAX);
+    }
+    Value toEnd = values.back();
 
-    static const std::string_view cmdTO("TO");
-    static const std::string_view cmdSTEP("STEP");
-    double toEnd = start;
-    double step  = 1;
-    for (size_t i = 4; i < tokens.size(); ++i) {
-        if (tokens[i].is(cmdTO)) {
-            auto values = evaluateExpression(tokens, i + 1);
-            if (values.size() != 1) {
-                throw Error(ErrorId::SYNTAX);
-            }
-            toEnd = ValueToDouble(values.back());
+    Value step = int64_t(1);
+    if (i < tokens.size()) {
+        if (!tokens[i].is(cmdSTEP)) {
+            throw Error(ErrorId::SYNTAX);
         }
-        if (tokens[i].is(cmdSTEP)) {
-            auto values = evaluateExpression(tokens, i + 1);
-            if (values.size() != 1) {
-                throw Error(ErrorId::SYNTAX);
-            }
-            step = ValueToDouble(values.back());
+        values = evaluateExpression(tokens, i + 1);
+        if (values.size() != 1) {
+            throw Error(ErrorId::SYNTAX);
         }
+        step = values.back();
     }
-    modl.variables[varName] = start;
 
-    // re-use the same loop variable if it's on the stack.
-    Basic::LoopItem loopParam { Basic::LoopItem::FORNEXT, varName, start, toEnd, step, modl.programCounter };
+    auto& modl = currentModule();
+
+    Basic::LoopItem loopParam;
+    loopParam.type     = Basic::LoopItem::FORNEXT;
+    loopParam.variable = &modl.findOrCreateVariable(tokens[1].str())->second;
+    loopParam.end      = ValueToDouble(toEnd);
+    loopParam.step     = ValueToDouble(step);
+    loopParam.jump     = modl.programCounter;
+
+    // FOR I% with a whole step counts in integers
+    if (tokens[1].valuePostfix() == '%' && loopParam.step == std::floor(loopParam.step)) {
+        loopParam.isInteger = true;
+        loopParam.iend      = ValueToInt(toEnd);
+        loopParam.istep     = ValueToInt(step);
+        *loopParam.variable = ValueToInt(start);
+    } else {
+        *loopParam.variable = ValueToDouble(start);
+    }
 
-    for (int i = int(modl.loopStack.size()) - 1; i >= 0; --i) {
-        auto& it = modl.loopStack[i];
-        if (it.type != Basic::LoopItem::FORNEXT) {
+    // re-use the same loop variable if it's on the stack.
+    for (size_t n = modl.loopStack.size(); n-- > 0;) {
+        if (modl.loopStack[n].type != Basic::LoopItem::FORNEXT) {
             break;
         }
-        if (modl.loopStack[i].varName == varName) {
+        if (modl.loopStack[n].variable == loopParam.variable) {
             // pop any inner loops and this loop
-            while (modl.loopStack.size() > i) {
-                modl.loopStack.pop_back();
-            }
+            modl.loopStack.resize(n);
             break;
         }
     }
@@ -4712,59 +5430,56 @@ FOR A=1 TO 2:FOR B=1 TO 2:PRINT A,B:NEXT B,A
 ...
 */
 void Basic::handleNEXT(const std::vector<Token>& tokens) {
-    auto& modl = currentModule();
-    static const std::string EMPTY("");
+    auto& modl  = currentModule();
+    auto& stack = modl.loopStack;
 
-    const std::string& varName = (tokens.size() > 1) ? tokens[1].str() : EMPTY;
-    if (tokens.size() > 1) {
-        for (int i = int(modl.loopStack.size()) - 1; i >= 0; --i) {
-            auto& it = modl.loopStack[i];
-            if (it.type != Basic::LoopItem::FORNEXT) {
-                break;
+    auto sgn = [](auto n) -> int { return (n > 0) ? 1 : (n < 0 ? -1 : 0); };
+
+    // NEXT [A [, B ...]]. The variable names are at tokens[1], [3], ...
+    for (size_t t = 1;; t += 2) {
+        Value* variable = nullptr;
+        if (t < tokens.size()) {
+            auto varit = modl.variables.find(tokens[t].str());
+            if (varit == modl.variables.end()) {
+                throw Error(ErrorId::NEXT_WITHOUT_FOR);
             }
-            if (modl.loopStack[i].varName == varName) {
-                // pop any inner loops
-                while (modl.loopStack.size() > i + 1) {
-                    modl.loopStack.pop_back();
+            variable = &varit->second;
+
+            // pop any inner loops
+            for (size_t n = stack.size(); n-- > 0;) {
+                if (stack[n].type != Basic::LoopItem::FORNEXT) {
+                    break;
+                }
+                if (stack[n].variable == variable) {
+                    stack.resize(n + 1);
+                    break;
                 }
-                break;
             }
         }
-    }
-    if (modl.loopStack.empty()) {
-        throw Error(ErrorId::NEXT_WITHOUT_FOR);
-    }
-    if (varName.empty()) {
-        if (modl.loopStack.back().type != Basic::LoopItem::FORNEXT) {
+        if (stack.empty() || stack.back().type != Basic::LoopItem::FORNEXT
+            || (variable != nullptr && stack.back().variable != variable)) {
             throw Error(ErrorId::NEXT_WITHOUT_FOR);
         }
-    } else if (modl.loopStack.back().varName != varName) {
-        throw Error(ErrorId::NEXT_WITHOUT_FOR);
-    }
-
 
+        const auto& loop = stack.back();
+        bool again       = false;
+        if (loop.isInteger && std::holds_alternative<int64_t>(*loop.variable)) {
+            int64_t& v = std::get<int64_t>(*loop.variable);
+            v += loop.istep;
+            again = sgn(v - loop.iend) != sgn(loop.istep);
+        } else {
+            double loopVar = ValueToDouble(*loop.variable) + loop.step;
+            *loop.variable = loopVar;
+            again          = sgn(loopVar - loop.end) != sgn(loop.step);
+        }
 
-    const auto& loop = modl.loopStack.back();
-    Value& v         = modl.variables[loop.varName];
-    double loopVar   = ValueToDouble(v) + loop.step;
-    v                = loopVar;
-
-    // debug("next "); debug(loop.varName.c_str()); debug("="); debug(ValueToString(v).c_str()); debug("\n");
-
-    auto sgn = [](double n) -> int { return (n > 0.0) ? 1 : (n < 0.0 ? -1 : 0); };
-    if (sgn(loopVar - loop.end) != sgn(loop.step)) {
-        // (loop.step > 0 && loopVar <= loop.end)
-        // || (loop.step < 0 && loopVar >= loop.end)
-        // ) {
-        modl.programCounter = loop.jump;
-    } else {
-        modl.loopStack.pop_back();
-        if (tokens.size() > 3) {
-            // NEXT A , B
-            auto copy = tokens;
-            copy.erase(copy.begin() + 1);
-            copy.erase(copy.begin() + 1);
-            handleNEXT(copy);
+        if (again) {
+            modl.programCounter = loop.jump;
+            return;
+        }
+        stack.pop_back();
+        if (t + 2 >= tokens.size()) {
+            return;
         }
     }
 }
@@ -4776,6 +5491,15 @@ void Basic::handleIFTHEN(const std::vector<Token>& tokens) {
         throw Error(ErrorId::SYNTAX);
     }
     if (ValueToInt(values[0]) != 0 && endtok > 0) {
+        // THEN 110, GOTO 110
+        static const std::string_view cmdGOTO("GOTO");
+        static const std::string_view cmdTHEN("THEN");
+        if (tokens.size() == endtok + 2 && isLiteralLine(tokens[endtok + 1])
+            && (tokens[endtok].is(cmdTHEN) || tokens[endtok].is(cmdGOTO))) {
+            doGOTO(int(ValueToInt(tokens[endtok + 1].tv)), false, &tokens[endtok + 1].lineSlot);
+            return;
+        }
+
         auto copyTok = tokens; // TODO you can do better than this
         copyTok.erase(copyTok.begin(), copyTok.begin() + (endtok));
 
@@ -4783,14 +5507,11 @@ void Basic::handleIFTHEN(const std::vector<Token>& tokens) {
             throw Error(ErrorId::SYNTAX);
         }
 
-        // THEN 110
-        static const std::string_view cmdGOTO("GOTO");
         if (copyTok.size() > 1 && copyTok[1].type == TokenType::INTEGER) {
             copyTok[0].type              = TokenType::KEYWORD;
             copyTok[0].valueForDebugging = "GOTO";
             copyTok[0].tv                = "GOTO"; // TODO slow copy
         }
-        static const std::string_view cmdTHEN("THEN");
         if (copyTok.begin()->is(cmdTHEN)) {
             // THEN PRINT ...
             copyTok.erase(copyTok.begin(), copyTok.begin() + 1);
@@ -4802,155 +5523,112 @@ void Basic::handleIFTHEN(const std::vector<Token>& tokens) {
     }
 }
 
-void Basic::readNextData(BA67::Value* pval, char valuePostfix) {
-    auto& cm = currentModule();
-
-    // std::vector<Basic::Token> tokens;
-    for (;;) {
-        // try {
-        //     tokens = tokenizeNextCommand(&cm.readDataPosition);
-        // } catch (...) {
-        //     // that's a syntax error in a line above the DATA
-        //     // throw Error(ErrorId::INTERNAL);
-        //     tokens = {};
-        // }
-
+// collect the items of all DATA statements once. READ just moves dataPointer.
+// The old position means nothing in the new pool, start over like RESTORE.
+void Basic::buildDataPool(Module& module) {
+    module.dataPool.clear();
+    module.dataLines.clear();
+    module.dataPoolDirty = false;
+    module.restoreDataPosition();
 
-        ProgramCounter& pcOfThisData = cm.readDataPosition;
-        ensureTokenized(cm, pcOfThisData);
-        if (pcOfThisData.cmdpos >= pcOfThisData.line->second.tokens.size()) {
-            ++pcOfThisData.line;
-            pcOfThisData.cmdpos = 0;
-            cm.readDataIndex    = 0;
-            if (pcOfThisData.line == cm.listing.end()) {
-                throw Error(ErrorId::OUT_OF_DATA);
-            }
+    static const std::string_view cmdDATA("DATA");
+    for (auto& ln : module.listing) {
+        if (ln.first < 0) {
             continue;
         }
-
-        auto& tokens = pcOfThisData.line->second.tokens[pcOfThisData.cmdpos];
-
-        if (tokens.empty()) {
-            // TODO can't be.
-            cm.readDataPosition.cmdpos++;
-            continue;
+        if (ln.second.tokens.empty()) {
+            try {
+                tokenizeLine(ln.second);
+            } catch (...) {
+                continue; // syntax errors show up when the line runs
+            }
         }
 
-        // if (tokens.empty()) {
-        //     ++cm.readDataPosition.line;
-        //     cm.readDataPosition.cmdpos = 0;
-        //     cm.readDataIndex           = 0;
-        //     if (cm.readDataPosition.line == cm.listing.end()) {
-        //         throw Error(ErrorId::OUT_OF_DATA);
-        //     }
-        //     continue;
-        // } else
-        static const std::string_view cmdDATA("DATA");
-        if (tokens[0].is(cmdDATA)) {
-            auto pcAfterThisData = cm.readDataPosition; // where to read next DATA
-            pcAfterThisData.cmdpos++;
-
-            cm.readDataPosition = pcOfThisData; // rewind to this DATA for more values
-
-            // this is a hack. When the last data is a comma, there is
-            // one empty data piece at the end of that line - which is not tokenized!
-            // This way, we add an empty item.
-            if (tokens.back().type == TokenType::COMMA) {
-                Token t {};
-                if (valuePostfix == '$') {
-                    t.type              = TokenType::STRING;
-                    t.valueForDebugging = "";
-                    t.tv                = std::string("");
-                } else {
-                    t.type              = TokenType::INTEGER;
-                    t.valueForDebugging = "0";
-                    t.tv                = 0LL;
-                }
-                tokens.push_back(t);
+        bool lineHasData = false;
+        for (auto& tokens : ln.second.tokens) {
+            if (tokens.empty() || !tokens[0].is(cmdDATA)) {
+                continue;
+            }
+            if (!lineHasData) {
+                module.dataLines.push_back({ ln.first, module.dataPool.size() });
+                lineHasData = true;
             }
 
-
-            bool previousWasComma = false;
-            int nthData           = 0;
-            bool unaryMinus       = false;
+            // DATA 1, -2, "three", four,, 6,
+            bool expectItem = true;
+            bool hadComma   = false;
+            bool negative   = false;
             for (size_t itok = 1 /* skip "DATA"*/; itok < tokens.size(); ++itok) {
-                if (nthData == cm.readDataIndex && tokens[itok].type == TokenType::OPERATOR) {
-                    if (tokens[itok].is('-')) {
-                        unaryMinus = true;
-                        ++itok;
-                    }
-                }
-
                 auto& t = tokens[itok];
-                if (nthData == cm.readDataIndex) {
-                    ++cm.readDataIndex;
-                    bool skipComma = true;
-                    switch (t.type) {
-                    case TokenType::STRING:
-                    case TokenType::IDENTIFIER:
-                        if (valuePostfix != '$') {
-                            throw Error(ErrorId::TYPE_MISMATCH);
-                        }
-                        *pval = t.tv; // TODO slow: this is a full copy
-                        break;
-                    case TokenType::INTEGER:
-                        if (valuePostfix == '$') {
-                            throw Error(ErrorId::TYPE_MISMATCH);
-                        }
-                        *pval = unaryMinus ? -ValueToInt(t.tv) : ValueToInt(t.tv);
-                        break;
-                    case TokenType::NUMBER:
-                        if (valuePostfix == '$') {
-                            throw Error(ErrorId::TYPE_MISMATCH);
-                        }
-                        *pval = unaryMinus ? -ValueToDouble(t.tv) : ValueToDouble(t.tv);
-                        break;
-                    case TokenType::COMMA:
-                        skipComma = false;
-                        // empty data statement
-                        if (valuePostfix == '$') {
-                            *pval = std::string("");
-                        } else {
-                            *pval = int64_t(0);
-                        }
-                        break;
-                    default: break;
+                switch (t.type) {
+                case TokenType::COMMA:
+                    if (expectItem) {
+                        module.dataPool.push_back({ Value(), true });
                     }
-
-                    // skip following comma
-                    if (skipComma && itok + 1 < tokens.size() && tokens[itok + 1].type == TokenType::COMMA) {
-                        if (unaryMinus) {
-                            ++cm.readDataIndex;
-                        }
-                        ++cm.readDataIndex;
+                    expectItem = true;
+                    hadComma   = true;
+                    break;
+                case TokenType::OPERATOR:
+                case TokenType::UNARY_OPERATOR:
+                    if (t.is('-')) {
+                        negative = !negative;
                     }
-                    return;
+                    break;
+                case TokenType::STRING:
+                case TokenType::IDENTIFIER:
+                    module.dataPool.push_back({ t.tv });
+                    expectItem = false;
+                    break;
+                case TokenType::INTEGER:
+                    module.dataPool.push_back({ Value(negative ? -ValueToInt(t.tv) : ValueToInt(t.tv)) });
+                    negative   = false;
+                    expectItem = false;
+                    break;
+                case TokenType::NUMBER:
+                    module.dataPool.push_back({ Value(negative ? -ValueToDouble(t.tv) : ValueToDouble(t.tv)) });
+                    negative   = false;
+                    expectItem = false;
+                    break;
+                default: break;
                 }
-                ++nthData;
             }
+            // a trailing comma is followed by one empty item
+            if (expectItem && hadComma) {
+                module.dataPool.push_back({ Value(), true });
+            }
+        }
+    }
+}
 
+void Basic::readNextData(const ValueRef& pval, char valuePostfix) {
+    auto& cm = currentModule();
+    if (cm.dataPoolDirty) {
+        buildDataPool(cm);
+    }
+    if (cm.dataPointer >= cm.dataPool.size()) {
+        throw Error(ErrorId::OUT_OF_DATA);
+    }
 
-
-
-            // end of this DATA - read from next DATA
-            ASSERT(nthData == cm.readDataIndex);
-
-            cm.readDataPosition = pcAfterThisData;
-            cm.readDataIndex    = 0;
+    const auto& item = cm.dataPool[cm.dataPointer++];
+    if (item.isEmpty) {
+        if (valuePostfix == '$') {
+            *pval = std::string("");
         } else {
-            ++cm.readDataPosition.cmdpos;
+            *pval = int64_t(0);
         }
+        return;
     }
-
-
-    throw Error(ErrorId::INTERNAL);
+    if (ValueIsString(item.value) != (valuePostfix == '$')) {
+        throw Error(ErrorId::TYPE_MISMATCH);
+    }
+    *pval = item.value;
 }
 
 void Basic::handleREAD(const std::vector<Token>& tokens) {
     for (size_t itk = 1; itk < tokens.size(); ++itk) {
         auto& tk = tokens[itk];
         if (tk.type == TokenType::IDENTIFIER) {
-            Value* pval = findLeftValue(currentModule(), tokens, itk, &itk);
+            ValueRef pval = findLeftValue(currentModule(), tokens, itk, &itk);
             if (pval == nullptr) {
                 throw Error(ErrorId::SYNTAX);
             }
@@ -4969,15 +5647,16 @@ void Basic::handleRESTORE(const std::vector<Token>& tokens) {
         cm.restoreDataPosition();
     } else {
         int line = int(ValueToInt(args[0]));
-        for (auto it = cm.listing.begin(); it != cm.listing.end(); ++it) {
-            if (it->first == line) {
-                cm.readDataPosition.line   = it;
-                cm.readDataPosition.cmdpos = 0;
-                cm.readDataIndex           = 0;
-                return;
-            }
+        if (cm.findLine(line) == cm.listing.end()) {
+            throw Error(ErrorId::UNDEFD_STATEMENT);
         }
-        throw Error(ErrorId::UNDEFD_STATEMENT);
+        if (cm.dataPoolDirty) {
+            buildDataPool(cm);
+        }
+        // first DATA at or after that line
+        auto it = std::lower_bound(cm.dataLines.begin(), cm.dataLines.end(), line,
+                                   [](const std::pair<int32_t, size_t>& d, int32_t n) { return d.first < n; });
+        cm.dataPointer = (it == cm.dataLines.end()) ? cm.dataPool.size() : it->second;
     }
 }
 
@@ -4997,11 +5676,10 @@ void Basic::executeParsedTokens(const std::vector<Token>& tokens) {
     }
 
     if (!moduleVariableStack.back()->second.fastMode) {
-        static int tokenDelay = 0;
-        tokenDelay += int(tokens.size());
+        slowModeTokens += int(tokens.size());
         const int delayThreshold = 20;
-        if (tokenDelay > delayThreshold) {
-            tokenDelay -= delayThreshold;
+        if (slowModeTokens > delayThreshold) {
+            slowModeTokens -= delayThreshold;
             os->delay(5);
         }
     }
@@ -5080,6 +5758,10 @@ void Basic::executeParsedTokens(const std::vector<Token>& tokens) {
         } else if (tokens[0].is("DATA")) {
         } else if (tokens[0].is("KEY")) {
             handleKEY(tokens);
+        } else if (tokens[0].is("PROFILE")) {
+            handlePROFILE(tokens);
+        } else if (tokens[0].is("WORKER")) {
+            handleWORKER(tokens);
         } else if (tokens[0].is("RCHARDEF")) {
             handleRCHARDEF(tokens);
         } else if (tokens[0].is("DEF")) {
@@ -5092,6 +5774,12 @@ void Basic::executeParsedTokens(const std::vector<Token>& tokens) {
             handleDELETE(tokens);
         } else if (tokens[0].is("DUMP")) {
             handleDUMP(tokens);
+        } else if (tokens[0].is("ERASE")) {
+            handleERASE(tokens);
+        } else if (tokens[0].is("KEYS")) {
+            handleKEYS(tokens);
+        } else if (tokens[0].is("MAT")) {
+            handleMAT(tokens);
         } else if (tokens[0].is("CMD")) {
             handleCMD(tokens);
         } else {
@@ -5149,6 +5837,24 @@ void Basic::printUtf8String(const char* utf8, const char* pend, bool applyCtrlCo
     }
     char32_t quote = 0;
     if (currentFileNo == 0) {
+        if (os->settings.batchMode && !os->settings.benchmark) {
+            printBatchOutput(utf8, pend);
+        }
+
+        // printable characters are collected and written to the screen in runs
+        char32_t run[256];
+        size_t runLength = 0;
+        auto flush       = [&]() {
+            os->screen.chrout(run, runLength);
+            runLength = 0;
+        };
+        auto put = [&](char32_t c) {
+            if (runLength == std::size(run)) {
+                flush();
+            }
+            run[runLength++] = c;
+        };
+
         if (applyCtrlCodes) {
             while (utf8 < pend) {
                 char32_t c = Unicode::parseNextUtf8(utf8);
@@ -5168,7 +5874,8 @@ void Basic::printUtf8String(const char* utf8, const char* pend, bool applyCtrlCo
                     }
                 }
 
-                if (quote == 0) {
+                if (quote == 0 && ControlCharacters::isControlCharacter(c)) {
+                    flush();
                     switch (c) {
                     case ControlCharacters::cursorDown /*0x11*/:              os->screen.moveCursorPos(0, 1); break; // cursor down
                     case ControlCharacters::cursorRight /*0x1d*/:             os->screen.moveCursorPos(1, 0); break; // cursor right
@@ -5196,18 +5903,17 @@ void Basic::printUtf8String(const char* utf8, const char* pend, bool applyCtrlCo
                     case ControlCharacters::textColor13_Light_Green /*0x99*/: os->screen.setTextColor(13); break; // Light Green
                     case ControlCharacters::textColor14_Light_Blue /*0x9a*/:  os->screen.setTextColor(14); break; // Light Blue
                     case ControlCharacters::textColor15_Light_Gray /*0x9b*/:  os->screen.setTextColor(15); break; // Light Gray
-                    default:
-                        os->screen.chrout(c);
                     }
                 } else {
-                    os->screen.chrout(c);
+                    put(c);
                 }
             }
         } else {
             while (utf8 < pend) {
-                os->screen.chrout(Unicode::parseNextUtf8(utf8));
+                put(Unicode::parseNextUtf8(utf8));
             }
         }
+        flush();
 
         os->presentScreen();
     } else {
@@ -5223,7 +5929,72 @@ void Basic::printUtf8String(const char* utf8, const char* pend, bool applyCtrlCo
     }
 }
 
+// --batch: mirror the screen text to stdout. Control codes are dropped and
+// cursor jumps to the right (TAB, comma) are written as spaces.
+void Basic::printBatchOutput(const char* utf8, const char* pend) {
+    std::string out;
+    size_t x = os->screen.getCursorPos().x;
+    if (x > batchColumn) {
+        out.append(x - batchColumn, ' ');
+        batchColumn = x;
+    }
+    while (utf8 < pend) {
+        const char* start = utf8;
+        char32_t c        = Unicode::parseNextUtf8(utf8);
+        if (c == U'\n' || c == U'\r') {
+            out += '\n';
+            batchColumn = 0;
+        } else if (c >= 0x20 && !ControlCharacters::isControlCharacter(c)) {
+            out.append(start, utf8);
+            ++batchColumn;
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    if (!os->settings.goldenFile.empty()) {
+        batchOutput += out;
+    }
+}
+
+// a line from stdin without the line break. false at the end of the input.
+static bool readStdinLine(std::string& line) {
+    fflush(stdout); // show the prompt before waiting
+    line.clear();
+    int c = 0;
+    while ((c = fgetc(stdin)) != EOF && c != '\n') {
+        line += char(c);
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return c != EOF || !line.empty();
+}
+
+// --batch: INPUT reads the typed keys (--keys) up to RETURN, then lines from stdin.
+// Golden runs do not read stdin. Reading past the end is an OUT OF DATA error.
+std::string Basic::inputBatchLine() {
+    std::string line;
+    if (os->keyboardBufferHasData()) {
+        while (os->keyboardBufferHasData()) {
+            auto key = os->getFromKeyboardBuffer();
+            if (key.code == char32_t(Os::KeyConstant::RETURN)) {
+                break;
+            }
+            if (key.printable) {
+                Unicode::appendAsUtf8(line, key.code);
+            }
+        }
+        printUtf8String(line); // typed keys are echoed like on the screen
+    } else if (!os->settings.goldenFile.empty() || !readStdinLine(line)) {
+        throw Error(ErrorId::OUT_OF_DATA);
+    }
+    printUtf8String("\n");
+    return line;
+}
+
 std::string Basic::inputLine(bool allowVertical) {
+    if (os->settings.batchMode) {
+        return inputBatchLine();
+    }
     if (os->settings.demoMode) {
         os->delay(2000);
     }
@@ -5686,6 +6457,14 @@ void Basic::restoreColorsAndCursor(bool resetFont) {
     for (auto& s : os->screen.sprites) {
         s.enabled = false;
     }
+    os->screen.updateActiveSprites();
+    os->screen.spriteCollisions.reset();
+    os->screen.backgroundCollisions.reset();
+    collisionLine        = { -1, -1 };
+    collisionReturnDepth = 0;
+    lastContacts         = {};
+    collisionPending     = {};
+    collisionJiffy       = ~uint64_t(0);
 
     if (os->screen.getCursorPos().x != 0) {
         printUtf8String("\n");
@@ -5712,9 +6491,11 @@ Basic::ParseStatus Basic::parseInput(const char* pline) {
                 auto itr = cm.listing.find(int(n));
                 if (itr != cm.listing.end()) {
                     cm.listing.erase(itr);
+                    cm.listingChanged();
                 }
             } else {
                 ProgramLine& prgline = cm.listing[int32_t(n)];
+                cm.listingChanged();
 
                 prgline.code = pc;
                 StringHelper::trimRight(prgline.code, " \r\n\t");
@@ -5762,8 +6543,14 @@ Basic::ParseStatus Basic::parseInput(const char* pline) {
         }
 
         // execute listing code
-        runToEnd();
+        ScopedNanoseconds runTime(runNanoseconds);
+        try {
+            runToEnd();
+        } catch (const std::bad_alloc&) {
+            throw Error(ErrorId::OUT_OF_MEMORY); // e.g. the memory quota of BA67host
+        }
     } catch (const Error& e) {
+        ++errorsReported;
         currentFileNo = 0;
         // dumpVariables();
         storeProgramCounterForCont();
@@ -5773,6 +6560,14 @@ Basic::ParseStatus Basic::parseInput(const char* pline) {
             // std::string& line = pc.line->second;
             iline = pc.line->first;
         }
+        if (traceRing.running()) {
+            try {
+                dumpTrace(traceRing.file, "?" + std::string(e.what()) + " IN " + ValueToString(iline) + "\n");
+            } catch (const Error&) {
+                traceRing.stop(); // report the program's error, not the trace file's
+            }
+        }
+        lastError = std::string(e.what()) + " IN " + ValueToString(iline);
         if (iline >= 0) {
             restoreColorsAndCursor(true);
             std::string msg = "?" + std::string(e.what()) + " IN " + ValueToString(iline) + "\n";
@@ -5877,11 +6672,14 @@ void Basic::runInterpreter() {
         // debug("MODULE CODE "); debug(moduleListingStack.back()->first.c_str()); debug("\n");
 
         try {
-            line = inputLine(true);
+            waitingAtPrompt = true;
+            line            = inputLine(true);
+            waitingAtPrompt = false;
         } catch (const Error& e) {
             (void)e;
-            currentFileNo = 0;
-            status        = ParseStatus::PS_ERROR;
+            waitingAtPrompt = false;
+            currentFileNo   = 0;
+            status          = ParseStatus::PS_ERROR;
             continue;
         }
 
@@ -5891,33 +6689,28 @@ void Basic::runInterpreter() {
     }
 }
 
+// Basic interpreter loop for --batch. Executes the lines from stdin.
+// Returns 1 if any of them failed.
+int Basic::runBatch() {
+    int exitCode = 0;
+    std::string line;
+    while (readStdinLine(line)) {
+        uppercaseProgram(line);
+        if (parseInput(line.c_str()) == ParseStatus::PS_ERROR) {
+            exitCode = 1;
+        }
+    }
+    return exitCode;
+}
+
 // run from current program counter until END is hit
 void Basic::runToEnd() {
     bool programWasRunning = false; // still in immediate mode
-    int lastTraceLine      = -1;
     for (;;) {
         if (programCounter().line == currentListing().end()) {
             break;
         }
 
-        if (moduleListingStack.back()->second.traceOn && programCounter().line->first >= 0) {
-            int line = programCounter().line->first;
-            if (lastTraceLine != line) {
-                lastTraceLine = line;
-                auto& scn     = os->screen;
-                auto state    = scn.saveState(false);
-                scn.setTextColor(1);
-                scn.setBackgroundColor(0);
-                auto crsr        = scn.getCursorPos();
-                std::string text = "[" + ValueToString(line) + "]\n";
-                crsr.x           = scn.width - text.length();
-                scn.setCursorPos(crsr);
-                printUtf8String(text);
-                scn.restoreState(state);
-                // printf("%s", text.c_str());
-            }
-        }
-
         // debug("MODULE VARS "); debug(moduleVariableStack.back()->first.c_str()); debug("\n");
         // debug("MODULE CODE "); debug(moduleListingStack.back()->first.c_str()); debug("\n");
         auto& pc = programCounter();
@@ -5947,11 +6740,305 @@ void Basic::runToEnd() {
 
         ++pc.cmdpos; // next command
 
-        executeParsedTokens(tokens);
+        auto& listingModule = moduleListingStack.back()->second;
+        if (listingModule.traceOn && pc.line->first >= 0 && !tokens.empty()) {
+            bool isKeyword = tokens[0].type == TokenType::COMMAND || tokens[0].type == TokenType::KEYWORD;
+            traceRing.statement(pc.line->first, &listingModule, isKeyword ? std::string_view(tokens[0].str()) : std::string_view("LET"));
+        }
+        if ((++statementsExecuted & 0x3ff) == 0) {
+            dumpStatsIfDue();
+        }
+        if (profiler.on) {
+            // the stack is taken before a GOSUB or RETURN changes it
+            int32_t line = pc.line->first;
+            beginProfiledStatement(tokens);
+            uint64_t start = Profiler::now();
+            executeParsedTokens(tokens);
+            if (profiler.on) { // not after PROFILE OFF
+                profiler.addStatement(line, profileKeyword, profileStack, Profiler::now() - start);
+            }
+        } else {
+            executeParsedTokens(tokens);
+        }
+        if (programWasRunning && (collisionLine[0] >= 0 || collisionLine[1] >= 0)) {
+            checkCollisionInterrupt();
+        }
 
-        os->updateEvents();
-        os->presentScreen();
-        handleEscapeKey();
+        if (os->settings.batchMode) {
+            checkBatchLimits();
+        } else {
+            os->updateEvents();
+            os->presentScreen();
+            handleEscapeKey();
+        }
+    }
+}
+
+// PROFILE: the call stack frames and the keyword of the statement about to run.
+// A frame per entered module, per GOSUB caller line and the current line.
+void Basic::beginProfiledStatement(const std::vector<Token>& tokens) {
+    if (tokens.empty()) {
+        profileKeyword = "REM";
+    } else if (tokens[0].type == TokenType::COMMAND || tokens[0].type == TokenType::KEYWORD) {
+        profileKeyword = tokens[0].str();
+    } else {
+        profileKeyword = "LET";
+    }
+
+    profileStack = "main";
+    for (auto& mod : moduleListingStack) {
+        if (!mod->first.empty()) {
+            profileStack += ";MODULE ";
+            profileStack += mod->first;
+        }
+        for (auto& loop : mod->second.loopStack) {
+            if (loop.type == LoopItem::GOSUB && loop.jump.line != mod->second.listing.end() && loop.jump.line->first >= 0) {
+                profileStack += ';';
+                profileStack += std::to_string(loop.jump.line->first);
+            }
+        }
+    }
+    int32_t line = programCounter().line->first;
+    profileStack += ';';
+    profileStack += line < 0 ? std::string("DIRECT") : std::to_string(line);
+}
+
+// TRACE: the ring as text, oldest first, and a footer line
+void Basic::dumpTrace(const std::string& file, const std::string& footer) {
+    std::string text = traceRing.text([this](const void* module) {
+        for (auto& m : modules) {
+            if (&m.second == module) {
+                return m.first;
+            }
+        }
+        return std::string("?");
+    });
+    text += footer;
+
+    FilePtr fp(os);
+    fp.open(file, "wb");
+    if (!fp) {
+        throw Error(ErrorId::ILLEGAL_DEVICE);
+    }
+    fp.write(text.data(), text.size());
+}
+
+uint64_t Basic::uptimeMs() const {
+    return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+// the STATS counters of Basic and Os. Sizes are counted now, the rest since the start.
+std::vector<std::pair<std::string, uint64_t>> Basic::collectStats() {
+    uint64_t programLines = 0, variables = 0, arrays = 0, arrayElements = 0;
+    for (auto& m : modules) {
+        programLines += m.second.listing.size();
+        variables += m.second.variables.size();
+        arrays += m.second.arrays.size();
+        for (auto& a : m.second.arrays) {
+            auto& arr = a.second;
+            arrayElements += arr.doubles.size() + arr.integers.size() + arr.strings.size() + arr.dict.size();
+        }
+    }
+
+    uint64_t openFiles = 0, ipcIn = 0, ipcOut = 0;
+    for (auto& f : fileHandles) {
+        if (!f) {
+            continue;
+        }
+        ++openFiles;
+        if (auto ipc = f.ipcConnection()) {
+            ipcIn += ipc->inputPending();
+            ipcOut += ipc->outputPending();
+        }
+    }
+
+    return {
+        { "uptime_ms", uptimeMs() },
+        { "statements", statementsExecuted },
+        { "run_ms", runNanoseconds / 1000000 },
+        { "frames", os->frames },
+        { "frame_ms", os->frameNanoseconds / 1000000 },
+        { "frame_max_us", os->maxFrameNanoseconds / 1000 },
+        { "tokenized_lines", tokenizedLines },
+        { "errors", errorsReported },
+        { "modules", modules.size() },
+        { "program_lines", programLines },
+        { "variables", variables },
+        { "arrays", arrays },
+        { "array_elements", arrayElements },
+        { "keyboard_buffer", os->keyboardBufferSize() },
+        { "open_files", openFiles },
+        { "ipc_in_bytes", ipcIn },
+        { "ipc_out_bytes", ipcOut },
+    };
+}
+
+// one "name value" line per counter - the same on the screen and in the file
+std::string Basic::statsText() {
+    std::string text;
+    for (auto& s : collectStats()) {
+        text += s.first + " " + std::to_string(s.second) + "\n";
+    }
+    return text;
+}
+
+void Basic::dumpStats() {
+    std::string text = statsText() + "\n";
+
+    // append. FilePtr has no "a" mode
+    FilePtr file(os);
+    if (file.open(statsFile, "r+")) {
+        file.seek(0, SEEK_END);
+    } else if (!file.open(statsFile, "wb")) {
+        statsIntervalMs = 0;
+        throw Error(ErrorId::ILLEGAL_DEVICE);
+    }
+    file.write(text.data(), text.size());
+    nextStatsDumpMs = uptimeMs() + statsIntervalMs;
+}
+
+// called every 1024 statements and while waiting for keys
+void Basic::dumpStatsIfDue() {
+    if (statsIntervalMs != 0 && uptimeMs() >= nextStatsDumpMs) {
+        dumpStats();
+    }
+}
+
+// --batch: stop a runaway program. Exits like timeout(1) does.
+void Basic::checkBatchLimits() {
+    auto& sets = os->settings;
+    ++batchSteps;
+    const char* limit = nullptr;
+    if (sets.stepLimit != 0 && batchSteps > sets.stepLimit) {
+        limit = "STEP";
+    } else if (sets.timeLimitMs != 0 && (batchSteps & 0xff) == 0 && os->tick() > sets.timeLimitMs) {
+        limit = "TIME";
+    }
+    if (limit != nullptr) {
+        auto& pc = programCounter();
+        int line = pc.line != currentListing().end() ? pc.line->first : -1;
+        fflush(stdout);
+        fprintf(stderr, "?%s LIMIT EXCEEDED IN %d\n", limit, line);
+        exit(finishBatch(124));
+    }
+}
+
+// exit code, stdout and the final screen of a --batch run as text.
+// The colors are run-length encoded per row: count:colRam in hex.
+std::string Basic::batchDump(int exitCode) const {
+    auto& scn  = os->screen;
+    auto state = scn.saveState();
+    size_t w   = scn.width;
+    size_t h   = scn.height;
+
+    std::string dump = "exit " + std::to_string(exitCode) + "\n--- stdout\n" + batchOutput;
+    if (!batchOutput.empty() && batchOutput.back() != '\n') {
+        dump += '\n';
+    }
+
+    dump += "--- screen " + std::to_string(w) + "x" + std::to_string(h) + "\n";
+    for (size_t y = 0; y < h; ++y) {
+        std::string row;
+        for (size_t x = 0; x < w; ++x) {
+            char32_t c = char32_t(state.chars[y * w + x]);
+            Unicode::appendAsUtf8(row, c < 0x20 ? U' ' : c);
+        }
+        StringHelper::trimRight(row, " ");
+        dump += row + "\n";
+    }
+
+    dump += "--- colors\n";
+    for (size_t y = 0; y < h; ++y) {
+        const MEMCELL* colors = &state.colr[y * w];
+        std::string row;
+        for (size_t x = 0; x < w;) {
+            size_t n = 1;
+            while (x + n < w && colors[x + n] == colors[x]) {
+                ++n;
+            }
+            char token[32];
+            snprintf(token, sizeof(token), "%s%zu:%02x", row.empty() ? "" : " ", n, unsigned(colors[x] & 0xff));
+            row += token;
+            x += n;
+        }
+        dump += row + "\n";
+    }
+    return dump;
+}
+
+// --batch ends here. Compares the run with the golden file and returns the
+// exit code of the process: 0 if they match. A missing golden file is recorded.
+int Basic::finishBatch(int exitCode) {
+    fflush(stdout);
+    const std::string& golden = os->settings.goldenFile;
+    if (golden.empty()) {
+        return exitCode;
+    }
+
+    std::string dump = batchDump(exitCode);
+    if (os->settings.recordGolden) {
+        std::ofstream(golden, std::ios::binary) << dump;
+        fprintf(stderr, "recorded %s\n", golden.c_str());
+        return 0;
+    }
+    std::ifstream in(golden, std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "%s is missing. Run with --record to write it.\n", golden.c_str());
+        return 1;
+    }
+    std::string expected((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::erase(expected, '\r'); // checked out with CRLF
+    if (expected == dump) {
+        return 0;
+    }
+
+    // the first line that differs, and the whole run next to the working directory
+    size_t line = 1;
+    for (size_t i = 0; i < std::min(expected.size(), dump.size()) && expected[i] == dump[i]; ++i) {
+        if (dump[i] == '\n') {
+            ++line;
+        }
+    }
+    std::string actual = std::filesystem::path(golden).filename().string() + ".actual";
+    std::ofstream(actual, std::ios::binary) << dump;
+    fprintf(stderr, "%s differs in line %zu. This run is in %s\n", golden.c_str(), line, actual.c_str());
+    return 1;
+}
+
+// GOSUB the COLLISION handler when sprites collided. Not while the handler runs.
+void Basic::checkCollisionInterrupt() {
+    if (collisionReturnDepth != 0) {
+        if (currentModule().loopStack.size() >= collisionReturnDepth) {
+            return; // no RETURN, yet
+        }
+        collisionReturnDepth = 0;
+    }
+    if (programCounter().line == currentListing().end()) {
+        return; // END
+    }
+    // test again when a sprite changed, or once per frame for text under the sprites
+    auto& screen   = os->screen;
+    uint64_t jiffy = os->tick() * 60 / 1000;
+    if (screen.spritesChanged || jiffy != collisionJiffy) {
+        collisionJiffy = jiffy;
+
+        // only a new contact triggers, not sprites that keep overlapping
+        screen.detectCollisions();
+        auto newSprite     = screen.spriteContacts & ~lastContacts[0];
+        auto newBackground = screen.backgroundContacts & ~lastContacts[1];
+        lastContacts       = { screen.spriteContacts, screen.backgroundContacts };
+        collisionPending[0] |= collisionLine[0] >= 0 && newSprite.any();
+        collisionPending[1] |= collisionLine[1] >= 0 && newBackground.any();
+    }
+
+    // both kinds can start in the same check. The background handler runs after the RETURN of the sprite handler.
+    for (size_t type = 0; type < 2; ++type) {
+        if (collisionPending[type]) {
+            collisionPending[type] = false;
+            doGOTO(collisionLine[type], true);
+            collisionReturnDepth = currentModule().loopStack.size();
+            return;
+        }
     }
 }
 
@@ -6242,6 +7329,71 @@ bool Basic::fileExists(const std::string& filenameUtf8, bool allowWildCard) {
     return os->doesFileExist(filenameUtf8);
 }
 
+// values of the state file: a type byte, then 8 bytes or a length and the bytes of a string
+static void appendStateValue(std::string& blob, const Value& v) {
+    auto put64 = [&](uint64_t u) {
+        for (int i = 0; i < 8; ++i) {
+            blob += char((u >> (8 * i)) & 0xff);
+        }
+    };
+    if (auto i = std::get_if<int64_t>(&v)) {
+        blob += 'I';
+        put64(uint64_t(*i));
+    } else if (auto d = std::get_if<double>(&v)) {
+        uint64_t u;
+        memcpy(&u, d, sizeof(u));
+        blob += 'D';
+        put64(u);
+    } else {
+        std::string str = ValueToString(v);
+        blob += 'S';
+        put64(str.size());
+        blob += str;
+    }
+}
+
+static bool readStateValue(const std::string& blob, size_t& pos, Value& v) {
+    if (pos + 9 > blob.size()) {
+        return false;
+    }
+    char type  = blob[pos++];
+    uint64_t u = 0;
+    for (int i = 0; i < 8; ++i) {
+        u |= uint64_t(uint8_t(blob[pos++])) << (8 * i);
+    }
+    if (type == 'I') {
+        v = int64_t(u);
+    } else if (type == 'D') {
+        double d;
+        memcpy(&d, &u, sizeof(d));
+        v = d;
+    } else {
+        if (u > blob.size() - pos) {
+            return false;
+        }
+        v = blob.substr(pos, size_t(u));
+        pos += size_t(u);
+    }
+    return true;
+}
+
+// what saveState cannot keep: DEF FN functions and open files
+std::string Basic::unsavedState() const {
+    bool functions = false;
+    for (auto& m : modules) {
+        functions = functions || !m.second.functionTable.empty();
+    }
+    bool files = false;
+    for (auto& f : fileHandles) {
+        files = files || bool(f);
+    }
+    if (functions && files) {
+        return "DEF FN FUNCTIONS AND OPEN FILES";
+    }
+    return functions ? "DEF FN FUNCTIONS" : (files ? "OPEN FILES" : "");
+}
+
+// options, memory and all modules with their listings, variables and arrays
 bool Basic::saveState(std::string& filenameUtf8) {
     RawConfig cfg(os);
     cfg.set("options.spacingRequired", options.spacingRequired);
@@ -6253,20 +7405,64 @@ bool Basic::saveState(std::string& filenameUtf8) {
     cfg.set("rom", &cpu.ROM[0], cpu.ROM.size(), sizeof(cpu.ROM[0]));
     cfg.set("time0", time0);
 
-    auto& mod = currentModule();
-    cfg.set("module.fastmode", mod.fastMode);
-    cfg.set("module.traceOn", mod.traceOn);
-    cfg.set("module.autoNumbering", mod.autoNumbering);
-    cfg.set("module.lastEnteredLineNumber", mod.lastEnteredLineNumber);
-    cfg.set("module.filenameQSAVE", mod.filenameQSAVE);
-    int32_t nlines = int32_t(mod.listing.size());
-    cfg.set("module.linecount", nlines);
-    int64_t i = 0;
-    for (auto& ln : mod.listing) {
-        cfg.set("lst.ln" + std::to_string(i), ln.first);
-        cfg.set("lst.tx" + std::to_string(i), ln.second);
-        ++i;
+    int32_t nmodules = 0;
+    for (auto& [name, mod] : modules) {
+        std::string p = "mod" + std::to_string(nmodules++) + ".";
+        cfg.set(p + "name", name);
+        cfg.set(p + "fastmode", mod.fastMode);
+        cfg.set(p + "traceOn", mod.traceOn);
+        cfg.set(p + "autoNumbering", mod.autoNumbering);
+        cfg.set(p + "lastEnteredLineNumber", mod.lastEnteredLineNumber);
+        cfg.set(p + "filenameQSAVE", mod.filenameQSAVE);
+
+        int32_t nlines = 0;
+        for (auto& ln : mod.listing) {
+            if (ln.first >= 0) {
+                cfg.set(p + "ln" + std::to_string(nlines), ln.first);
+                cfg.set(p + "tx" + std::to_string(nlines), ln.second.code);
+                ++nlines;
+            }
+        }
+        cfg.set(p + "linecount", nlines);
+
+        std::string variables;
+        for (auto& v : mod.variables) {
+            appendStateValue(variables, v.first);
+            appendStateValue(variables, v.second);
+        }
+        cfg.set(p + "variables", variables);
+
+        int32_t narrays = 0;
+        for (auto& [arrayName, arr] : mod.arrays) {
+            std::string q = p + "arr" + std::to_string(narrays++) + ".";
+            cfg.set(q + "name", arrayName);
+            cfg.set(q + "dictionary", arr.isDictionary);
+            cfg.set(q + "type", int32_t(arr.type));
+            cfg.set(q + "bounds", &arr.bounds.index[0], arr.bounds.index.size(), sizeof(arr.bounds.index[0]));
+            std::string values;
+            if (arr.isDictionary) {
+                for (auto& e : arr.dict.entries()) {
+                    if (e.alive) {
+                        appendStateValue(values, e.key);
+                        appendStateValue(values, e.value);
+                    }
+                }
+                cfg.set(q + "values", values);
+            } else if (arr.type == Array::ElementType::String) {
+                for (auto& str : arr.strings) {
+                    appendStateValue(values, str);
+                }
+                cfg.set(q + "values", values);
+            } else if (arr.type == Array::ElementType::Integer) {
+                cfg.set(q + "values", arr.integers.data(), arr.integers.size(), sizeof(int64_t));
+            } else {
+                cfg.set(q + "values", arr.doubles.data(), arr.doubles.size(), sizeof(double));
+            }
+        }
+        cfg.set(p + "arraycount", narrays);
     }
+    cfg.set("modules.count", nmodules);
+    cfg.set("modules.current", moduleVariableStack.back()->first);
     cfg.save(filenameUtf8.c_str());
     return false;
 }
@@ -6283,28 +7479,112 @@ bool Basic::loadState(std::string& filenameUtf8) {
     cfg.get("rom", &cpu.ROM[0], cpu.ROM.size(), sizeof(cpu.ROM[0]));
     cfg.get("time0", time0);
 
-    auto& mod = currentModule();
-    cfg.get("module.fastmode", mod.fastMode);
-    cfg.get("module.traceOn", mod.traceOn);
-    cfg.get("module.autoNumbering", mod.autoNumbering);
-    cfg.get("module.lastEnteredLineNumber", mod.lastEnteredLineNumber);
-    cfg.get("module.filenameQSAVE", mod.filenameQSAVE);
-
-    mod.restoreDataPosition();
-    mod.setProgramCounterToEnd();
-    mod.listing.clear();
+    int32_t nmodules = 0;
+    if (!cfg.get("modules.count", nmodules)) {
+        // an older state file: the listing of one module
+        auto& mod = currentModule();
+        cfg.get("module.fastmode", mod.fastMode);
+        cfg.get("module.traceOn", mod.traceOn);
+        cfg.get("module.autoNumbering", mod.autoNumbering);
+        cfg.get("module.lastEnteredLineNumber", mod.lastEnteredLineNumber);
+        cfg.get("module.filenameQSAVE", mod.filenameQSAVE);
+
+        mod.restoreDataPosition();
+        mod.setProgramCounterToEnd();
+        mod.listing.clear();
+
+        int32_t nlines = 0;
+        cfg.get("module.linecount", nlines);
+
+        for (int32_t i = 0; i < nlines; ++i) {
+            ProgramLine pl;
+            int32_t lineNo = 0;
+            cfg.get("lst.ln" + std::to_string(i), lineNo);
+            cfg.get("lst.tx" + std::to_string(i), pl.code);
+            mod.listing[lineNo] = pl;
+        }
+        mod.forceTokenizing();
+        os->screen.dirtyFlag = true;
+        return true;
+    }
 
-    int32_t nlines = 0;
-    cfg.get("module.linecount", nlines);
+    moduleVariableStack.clear();
+    moduleListingStack.clear();
+    modules.clear();
+    modules[""] = {};
+    for (int32_t m = 0; m < nmodules; ++m) {
+        std::string p = "mod" + std::to_string(m) + ".";
+        std::string name;
+        cfg.get(p + "name", name);
+        auto& mod = modules[name];
+        cfg.get(p + "fastmode", mod.fastMode);
+        cfg.get(p + "traceOn", mod.traceOn);
+        cfg.get(p + "autoNumbering", mod.autoNumbering);
+        cfg.get(p + "lastEnteredLineNumber", mod.lastEnteredLineNumber);
+        cfg.get(p + "filenameQSAVE", mod.filenameQSAVE);
+
+        int32_t nlines = 0;
+        cfg.get(p + "linecount", nlines);
+        for (int32_t i = 0; i < nlines; ++i) {
+            int32_t lineNo = 0;
+            cfg.get(p + "ln" + std::to_string(i), lineNo);
+            cfg.get(p + "tx" + std::to_string(i), mod.listing[lineNo].code);
+        }
+        mod.setProgramCounterToEnd();
+        mod.forceTokenizing();
+
+        std::string variables;
+        cfg.get(p + "variables", variables);
+        Value varName, value;
+        for (size_t pos = 0; readStateValue(variables, pos, varName) && readStateValue(variables, pos, value);) {
+            mod.variables[ValueToString(varName)] = value;
+        }
+
+        int32_t narrays = 0;
+        cfg.get(p + "arraycount", narrays);
+        for (int32_t a = 0; a < narrays; ++a) {
+            std::string q = p + "arr" + std::to_string(a) + ".";
+            std::string arrayName;
+            cfg.get(q + "name", arrayName);
+            auto& arr          = mod.arrays[arrayName];
+            bool isDictionary  = false;
+            int32_t type       = 0;
+            ArrayIndex bounds;
+            cfg.get(q + "dictionary", isDictionary);
+            cfg.get(q + "type", type);
+            cfg.get(q + "bounds", &bounds.index[0], bounds.index.size(), sizeof(bounds.index[0]));
+            std::string values;
+            size_t pos = 0;
+            if (isDictionary) {
+                arr.setIsDictionary(true);
+                cfg.get(q + "values", values);
+                Value key;
+                while (readStateValue(values, pos, key) && readStateValue(values, pos, value)) {
+                    arr.dict.valueAt(arr.dict.findOrInsert(key)) = value;
+                }
+            } else if (Array::ElementType(type) == Array::ElementType::String) {
+                arr.dim(std::string(), bounds);
+                cfg.get(q + "values", values);
+                for (size_t i = 0; i < arr.strings.size() && readStateValue(values, pos, value); ++i) {
+                    arr.strings[i] = ValueToString(value);
+                }
+            } else if (Array::ElementType(type) == Array::ElementType::Integer) {
+                arr.dim(int64_t(0), bounds);
+                cfg.get(q + "values", arr.integers.data(), arr.integers.size(), sizeof(int64_t));
+            } else {
+                arr.dim(0.0, bounds);
+                cfg.get(q + "values", arr.doubles.data(), arr.doubles.size(), sizeof(double));
+            }
+        }
+    }
 
-    for (int32_t i = 0; i < nlines; ++i) {
-        ProgramLine pl;
-        int32_t lineNo = 0;
-        cfg.get("lst.ln" + std::to_string(i), lineNo);
-        cfg.get("lst.tx" + std::to_string(i), pl.code);
-        mod.listing[lineNo] = pl;
+    std::string current;
+    cfg.get("modules.current", current);
+    moduleVariableStack.push_back(modules.find(""));
+    moduleListingStack.push_back(modules.find(""));
+    if (!current.empty() && modules.find(current) != modules.end()) {
+        moduleVariableStack.push_back(modules.find(current));
     }
-    mod.forceTokenizing();
     os->screen.dirtyFlag = true;
     return true;
 }
@@ -6334,6 +7614,34 @@ Basic::Module::VariableMap::iterator Basic::Module::findOrCreateVariable(const s
     return varit;
 }
 
+std::map<int32_t, ProgramLine>::iterator Basic::Module::findLine(int32_t lineNumber, int32_t* slotCache) {
+    if (lineIndexDirty || lineIndex.size() != listing.size()) {
+        lineIndex.clear();
+        lineIndex.reserve(listing.size());
+        for (auto it = listing.begin(); it != listing.end(); ++it) {
+            lineIndex.push_back({ it->first, it });
+        }
+        lineIndexDirty = false;
+    }
+
+    if (slotCache != nullptr) {
+        int32_t slot = *slotCache;
+        if (slot >= 0 && size_t(slot) < lineIndex.size() && lineIndex[slot].lineNumber == lineNumber) {
+            return lineIndex[slot].line;
+        }
+    }
+
+    auto it = std::lower_bound(lineIndex.begin(), lineIndex.end(), lineNumber,
+                               [](const LineSlot& s, int32_t n) { return s.lineNumber < n; });
+    if (it == lineIndex.end() || it->lineNumber != lineNumber) {
+        return listing.end();
+    }
+    if (slotCache != nullptr) {
+        *slotCache = int32_t(it - lineIndex.begin());
+    }
+    return it->line;
+}
+
 
 bool Basic::AreYouSureQuestion() {
     printUtf8String("ARE YOU SURE (Y/N)?");
@@ -6347,17 +7655,12 @@ bool Basic::AreYouSureQuestion() {
 // machine memory monitor
 // returns true if emulation must continue
 bool Basic::monitor() {
-    static bool inMonitor = false;
-
     if (inMonitor) {
         return false;
     }
 
-    static std::vector<MEMCELL> cpmem(0x1000);
     // store and recall CPU memory from temp buffer
-    for (size_t i = 0; i < cpmem.size(); ++i) {
-        cpmem[i] = cpu.RAM[i];
-    }
+    std::vector<MEMCELL> cpmem(cpu.RAM.begin(), cpu.RAM.begin() + 0x1000);
     auto swapm = [&]() {for (size_t i = 0; i < cpmem.size(); ++i) {std::swap(cpmem[i], cpu.RAM[i]);} };
 
     cpu.breakPointHit = false;
@@ -6591,8 +7894,8 @@ bool Basic::monitor() {
                     to = uint16_t(from + file.tell());
                     file.seek(0, SEEK_SET);
                 }
+                std::vector<uint8_t> rbuf;
                 for (size_t i = from; i <= to; ++i) {
-                    static std::vector<uint8_t> rbuf;
                     if (file.read(rbuf, 1) == 1) {
                         cpu.setByte(uint16_t(i), rbuf[0]);
                     }
@@ -9,9 +9,12 @@
 #include <unordered_map>
 #include <variant>
 #include <vector>
-#include <list>
 #include "cpu-6502.h"
 #include "error.h"
+#include "value_dictionary.h"
+#include "profiler.h"
+#include "trace_ring.h"
+#include "module_worker.h"
 
 #include "os.h"
 using namespace BA67;
@@ -34,7 +37,7 @@ public:
         bool colorzizeListing = true;
         bool listDelay        = true; // add delay when list lines
     };
-    static Options options;
+    Options options;
 
     static double constexpr eps = 2.32830644e-10; // found by 10 E=1 20 IF1+E=1 THEN END 30 E=E/2: GOTO 20
 
@@ -69,10 +72,69 @@ public:
     // std::vector<MEMCELL> memory; // RAM for PEEK&POKE. charram, colram, lineLinkTable,...
 
     CPU6502 cpu;
+    CPU6502 rndCpu; // runs the ROM's RND routine for cbm_rnd. Holds the seed.
 
-    Value TIvariable;
-    Value TI$variable;
-    Value STvariable; // set with memory[krnl.STATUS] = Basic::FS_DEVICE_ERROR;
+    // TI, TI$, ST and STATUS. Computed on each read instead of being stored.
+    struct SystemVariable {
+        std::string_view name;
+        Value (*get)(Basic* basic);
+        void (*set)(Basic* basic, const Value& value); // nullptr: assignments are ignored
+    };
+    static const SystemVariable systemVariables[];
+    static int32_t systemVariableIndex(std::string_view name); // -1 if not a system variable
+    Value systemVariableValue; // findLeftValue returns the value of a system variable here
+    Value dictionarySizeVariable; // A$() = number of keys in a dictionary
+
+    // COLLISION type, line: GOSUB line when sprites collide. [0] sprite-sprite, [1] sprite-background
+    std::array<int, 2> collisionLine = { -1, -1 };
+    size_t collisionReturnDepth      = 0; // loopStack size inside the handler. 0: not in the handler
+    std::array<std::bitset<256>, 2> lastContacts; // ScreenBuffer::spriteContacts, backgroundContacts at the last check
+    uint64_t collisionJiffy              = ~uint64_t(0); // the 1/60 s of the last check
+    std::array<bool, 2> collisionPending = {}; // a new contact waits for its handler
+    void checkCollisionInterrupt();
+
+    // --batch: the screen text is mirrored to stdout, INPUT reads lines from stdin
+    size_t batchColumn  = 0; // characters written to the current stdout line
+    uint64_t batchSteps = 0; // statements executed, for BA68settings::stepLimit
+    int quitCode        = 0; // QUIT n with --bench, which runs the next program instead of exiting
+    std::string batchOutput; // stdout, kept for BA68settings::goldenFile
+    void printBatchOutput(const char* utf8, const char* pend);
+    std::string inputBatchLine();
+    void checkBatchLimits();
+    std::string batchDump(int exitCode) const;
+    int finishBatch(int exitCode);
+
+    // PROFILE ON/OFF/SAVE
+    Profiler profiler;
+    std::string profileStack; // "main;caller line;...;line" of the statement being timed
+    std::string profileKeyword; // its command or keyword
+    void beginProfiledStatement(const std::vector<Token>& tokens);
+
+    // STATS: counters of the interpreter itself. Cheap enough to stay on.
+    uint64_t statementsExecuted = 0;
+    uint64_t runNanoseconds     = 0; // in runToEnd, including presentScreen
+    uint64_t tokenizedLines     = 0;
+    uint64_t errorsReported     = 0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::string statsFile; // STATS file$, seconds: appended every statsIntervalMs
+    uint64_t statsIntervalMs = 0;
+    uint64_t nextStatsDumpMs = 0;
+    uint64_t uptimeMs() const;
+    std::vector<std::pair<std::string, uint64_t>> collectStats();
+    std::string statsText();
+    void dumpStats(); // append a "name value" block to statsFile
+    void dumpStatsIfDue();
+
+    // TRON/TROFF/TRACE. Modules with traceOn record their statements.
+    TraceRing traceRing;
+    void dumpTrace(const std::string& file, const std::string& footer); // throws on write errors
+
+    // WORKER/SEND/RECV. A worker is a module running in an interpreter on its own thread.
+    std::map<std::string, std::unique_ptr<ModuleWorker>> workers; // [module name]
+    ModuleWorker* asWorker = nullptr; // this interpreter runs a worker's program. "PARENT" is its channel.
+    std::string lastError; // "ERROR IN line" of the last parseInput that failed
+    void channelsOf(const std::string& name, Channel*& in, Channel*& out); // "PARENT" or a worker name
+    void waitForChannel(Channel& channel); // ESC and WORKER OFF still BREAK
 
     uint64_t time0; // time to subtract from tick() to get TI.
 
@@ -96,10 +158,19 @@ public:
     };
 
     struct Array {
-        std::vector<Value> data;
-        std::list<std::pair<Value, Value>> dict;
+        // element storage by type of the DIM value. Only one vector is used.
+        enum class ElementType : uint8_t { Double,
+                                           Integer,
+                                           String };
+        ElementType type = ElementType::Double;
+        std::vector<double> doubles;
+        std::vector<int64_t> integers;
+        std::vector<std::string> strings;
+
+        ValueDictionary dict; // DIM a$()
         bool isDictionary = false;
         ArrayIndex bounds = {}; // 5 = [0..4]
+        std::array<size_t, 4> strides = {}; // linear index = sum of index[n] * strides[n]
 
         // dim a(4) = (0..4)
         void dim(Value init, size_t i0, size_t i1 = 0, size_t i2 = 0, size_t i3 = 0);
@@ -107,26 +178,98 @@ public:
         void setIsDictionary(bool isDict) {
             isDictionary = isDict;
             if (isDict) {
-                data.clear();
+                doubles.clear();
+                integers.clear();
+                strings.clear();
             } else {
                 dict.clear();
             }
         }
-        Value& at(const ArrayIndex& ix);
-        Value& atKey(const Value& key) {
-            if (!isDictionary) {
+        size_t size() const;
+        // linear index of an element. Throws BAD_SUBSCRIPT
+        size_t indexOf(const ArrayIndex& ix) const {
+            if (isDictionary) {
                 throw BA67::Error(ErrorId::TYPE_MISMATCH);
             }
-            for (auto& p : dict) {
-                if (p.first == key) {
-                    return p.second;
+            size_t i = 0;
+            for (size_t n = 0; n < strides.size(); ++n) {
+                if (ix.index[n] > bounds.index[n]) {
+                    throw BA67::Error(ErrorId::BAD_SUBSCRIPT); // DIM a(5): a(6) = 1: REM a is defined (0..5)
                 }
+                i += ix.index[n] * strides[n];
             }
-            dict.emplace_back(key, Value {});
-            return dict.back().second;
+            return i;
+        }
+        // element i, or the i-th entry of a dictionary
+        Value get(size_t i) const {
+            if (isDictionary) {
+                return dict.valueAt(i);
+            }
+            switch (type) {
+            case ElementType::Integer: return integers[i];
+            case ElementType::String:  return strings[i];
+            default:                   return doubles[i];
+            }
+        }
+        void set(size_t i, const Value& v);
+        Value at(const ArrayIndex& ix) const { return get(indexOf(ix)); }
+        // entry index for a dictionary key. Adds missing keys.
+        size_t indexOfKey(const Value& key) {
+            if (!isDictionary) {
+                throw BA67::Error(ErrorId::TYPE_MISMATCH);
+            }
+            return dict.findOrInsert(key);
         }
     };
 
+    // assignable value: a variable, a typed array element or a dictionary entry.
+    // Use it like a Value*: *ref = x; Value v = *ref;
+    class ValueRef {
+    public:
+        ValueRef() = default;
+        ValueRef(std::nullptr_t) { }
+        ValueRef(Value* v)
+            : value(v) { }
+        ValueRef(Array* arr, size_t i)
+            : array(arr)
+            , index(i) { }
+        // a value that can be read, but not assigned. A$() e.g.
+        static ValueRef readOnly(Value* v) {
+            ValueRef ref(v);
+            ref.isReadOnly = true;
+            return ref;
+        }
+        bool operator==(std::nullptr_t) const { return value == nullptr && array == nullptr; }
+
+        Value get() const { return value != nullptr ? *value : array->get(index); }
+        void set(const Value& v) const {
+            if (isReadOnly) {
+                throw BA67::Error(ErrorId::SYNTAX);
+            }
+            if (value != nullptr) {
+                *value = v;
+            } else {
+                array->set(index, v);
+            }
+        }
+
+        struct Proxy {
+            const ValueRef& ref;
+            operator Value() const { return ref.get(); }
+            const Proxy& operator=(const Value& v) const {
+                ref.set(v);
+                return *this;
+            }
+        };
+        Proxy operator*() const { return { *this }; }
+
+    private:
+        Value* value = nullptr;
+        Array* array    = nullptr;
+        size_t index    = 0;
+        bool isReadOnly = false;
+    };
+
 
     struct ProgramCounter {
         std::map<int, ProgramLine>::iterator line;
@@ -134,21 +277,21 @@ public:
         // size_t position; // character index in program code
     };
 
-    // Loop stack for nested FOR loops and GOSUB stack
+    // Loop stack for nested FOR loops and GOSUB stack.
+    // Plain data, so pushing and popping frames never allocates.
     struct LoopItem {
-        enum LoopType {
+        enum LoopType : uint8_t {
             GOSUB   = 1,
             FORNEXT = 2
         } type
             = GOSUB;
+        bool isInteger = false; // FOR I% = ... uses iend and istep
 
-        std::string varName; // FOR variable name or "GOSUB"
-        double start = 0;
-        double end   = 0;
-        double step  = 1;
-
-        // int line_number;
-        // size_t char_position;
+        Value* variable = nullptr; // FOR variable in Module::variables
+        double end      = 0;
+        double step     = 1;
+        int64_t iend    = 0;
+        int64_t istep   = 1;
 
         ProgramCounter jump; // where to jump on RETURN/NEXT
     };
@@ -160,16 +303,21 @@ public:
         // std::string lineCopy; // because Token has string_views
         std::vector<Token> parameters;
 
-        std::vector<Token> body; // if this has values, the function was defined with =
+        std::vector<Token> body; // if this has values, the function was defined with =. Parameters are PARAMETER tokens.
         int32_t gotoLine = 0; // if body is empty, goto the end of this line, return when hitting FNEND
+        int32_t gotoSlot = -1; // cached lineIndex slot of gotoLine
         void clear() {
             fnName.clear();
             //lineCopy.clear();
             parameters.clear();
             body.clear();
             gotoLine = 0;
+            gotoSlot = -1;
         }
     };
+    // arguments of the DEF FN calls being evaluated, innermost last.
+    // Comma separated like the function arguments: parameter n is at [2 * n].
+    std::vector<const std::vector<Value>*> fnArguments;
 
     // Files
     std::vector<FilePtr> fileHandles; // [0..0xff]
@@ -192,6 +340,21 @@ public:
         std::string filenameQSAVE;
         std::map<int32_t, ProgramLine> listing; // [basic number] = line
 
+        // sorted flat copy of the listing for GOTO and GOSUB.
+        // Rebuilt when lines were added or listingChanged() was called.
+        struct LineSlot {
+            int32_t lineNumber;
+            std::map<int32_t, ProgramLine>::iterator line;
+        };
+        std::vector<LineSlot> lineIndex;
+        bool lineIndexDirty = true;
+        void listingChanged() {
+            lineIndexDirty = true;
+            dataPoolDirty  = true;
+        }
+        // line or listing.end(). slotCache remembers the lineIndex slot for the next call.
+        std::map<int32_t, ProgramLine>::iterator findLine(int32_t lineNumber, int32_t* slotCache = nullptr);
+
         using VariableMap      = std::unordered_map<std::string, Value, string_hash, std::equal_to<>>;
         using ArrayVariableMap = std::unordered_map<std::string, Array, string_hash, std::equal_to<>>;
 
@@ -211,17 +374,20 @@ public:
         int32_t lineNumberForCONT     = 0; // where to continue with CONT command
         size_t tokenIndexForCONT      = 0; // where to continue with CONT
 
-        ProgramCounter readDataPosition = { listing.begin(), 0 };
-        int readDataIndex               = 0; // from the data at readDataPosition, read the readDataIndex's element next
+        // all DATA items of the listing, parsed on the first READ or RESTORE
+        struct DataItem {
+            Value value;
+            bool isEmpty = false; // DATA 1,,2 reads "" or 0
+        };
+        std::vector<DataItem> dataPool;
+        std::vector<std::pair<int32_t, size_t>> dataLines; // line number -> first item in dataPool
+        size_t dataPointer = 0; // next item to READ
+        bool dataPoolDirty = true;
 
         bool fastMode = true;
         bool traceOn  = false;
 
-        void restoreDataPosition() {
-            readDataPosition.line   = listing.begin();
-            readDataPosition.cmdpos = 0;
-            readDataIndex           = 0;
-        }
+        void restoreDataPosition() { dataPointer = 0; }
 
         void setProgramCounterToEnd() {
             programCounter.line   = listing.end();
@@ -236,6 +402,7 @@ public:
             for (auto& ln : listing) {
                 ln.second.tokens.clear();
             }
+            listingChanged();
         }
     };
 
@@ -313,17 +480,22 @@ protected:
     void handleINPUT(const std::vector<Token>& tokens);
     void handleNETGET(const std::vector<Token>& tokens);
     void handleDIM(const std::vector<Token>& tokens);
+    void handleERASE(const std::vector<Token>& tokens);
+    void handleKEYS(const std::vector<Token>& tokens);
+    void handleMAT(const std::vector<Token>& tokens);
     void handleLIST(const std::vector<Token>& tokens);
     void handleDELETE(const std::vector<Token>& tokens);
     void handleDUMP(const std::vector<Token>& tokens);
     void handleKEY(const std::vector<Token>& tokens);
+    void handlePROFILE(const std::vector<Token>& tokens);
+    void handleWORKER(const std::vector<Token>& tokens);
     void handleRCHARDEF(const std::vector<Token>& tokens);
 
 
     // find assignable value from 'a' or arr(1+3). returns nullptr on error
-    Value* findLeftValue(Module& module, const std::vector<Token>& tokens, size_t start, size_t* endPtr, bool allowDimArray = false);
+    ValueRef findLeftValue(Module& module, const std::vector<Token>& tokens, size_t start, size_t* endPtr, bool allowDimArray = false);
 
-    void doGOTO(int line, bool isGoSub);
+    void doGOTO(int line, bool isGoSub, int32_t* slotCache = nullptr);
     void handleGOTO(const std::vector<Token>& tokens);
     void handleGOSUB(const std::vector<Token>& tokens);
     void handleONGOTO(const std::vector<Token>& tokens);
@@ -334,7 +506,8 @@ protected:
 
     void handleIFTHEN(const std::vector<Token>& tokens);
 
-    void readNextData(Value* pval, char valuePostfix);
+    void readNextData(const ValueRef& pval, char valuePostfix);
+    void buildDataPool(Module& module);
     void handleREAD(const std::vector<Token>& tokens);
     void handleRESTORE(const std::vector<Token>& tokens);
 
@@ -344,9 +517,16 @@ protected:
 
     std::array<std::string, 12> keyShortcuts; // F1..F12 key shortcuts. Set with KEY command
 
+    int listLastFrom   = 0; // LIST - repeats the last range
+    int listLastTo     = 0x7fffffff;
+    int slowModeTokens = 0; // SLOW: tokens since the last delay
+    int gotoCount      = 0; // Emscripten: GOTOs since the last delay
+    bool inMonitor     = false;
+
 public:
     // bool isCursorActive = true; // screen.cursor.active
-    bool insertMode = false; // insert/overwrite Alt+INS
+    bool insertMode        = false; // insert/overwrite Alt+INS
+    bool c64ModeNeedsReset = true; // GO 64 cold starts the ROM only the first time
 
     void uppercaseProgram(std::string& line);
 
@@ -374,6 +554,8 @@ public:
 
     void handleEscapeKey(bool allowPauseWithShift = false);
     void runInterpreter();
+    bool waitingAtPrompt = false; // runInterpreter reads a direct mode line, no program runs
+    int runBatch(); // runInterpreter for --batch. Returns the exit code
     void runToEnd();
 
     void waitForKeypress();
@@ -385,6 +567,7 @@ public:
 
     bool saveState(std::string& filenameUtf8);
     bool loadState(std::string& filenameUtf8);
+    std::string unsavedState() const; // what saveState cannot keep. Empty if nothing.
 
     bool AreYouSureQuestion();
     bool monitor();
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <array>
 #include "cpu-6502.h"
+#include "cbm_rnd.h"
 
 class cbm_float {
 public:
@@ -428,11 +429,10 @@ public:
 
 
 
-double cbm_rnd(double x) {
+double cbm_rnd(CPU6502& cpu, double x) {
 #if 1
     // use the 6502 CPU to actually perform the CBM BASIC RND() routine
     cbm_float fx(x);
-    static CPU6502 cpu {};
 
     for (int i = 0; i < 7; ++i) {
         cpu.RAM[0x61 + i] = fx[i];
@@ -1,2 +1,6 @@
 #pragma once
-double cbm_rnd(double x); // C64 RND values for X <> 0
\ No newline at end of file
+class CPU6502;
+
+// C64 RND values for X <> 0. The seed is kept in the RAM of cpu,
+// which must be a CPU that only runs RND.
+double cbm_rnd(CPU6502& cpu, double x);
@@ -89,6 +89,8 @@ class CharMap {
 public:
     CharMap();
     ~CharMap() { delete unicode; }
+    CharMap(const CharMap&)            = delete;
+    CharMap& operator=(const CharMap&) = delete;
     void init(char32_t from = 0, char32_t to = char32_t(-1));
 
     std::array<CharBitmap, 160> ascii; // ASCII including control codes up to 159/0x9f
@@ -28,6 +28,39 @@ struct ControlCharacters {
     static const uint8_t textColor14_Light_Blue  = 0x9a;
     static const uint8_t textColor15_Light_Gray  = 0x9b;
 
+    // characters that PRINT handles instead of putting them on the screen
+    static bool isControlCharacter(char32_t c) {
+        switch (c) {
+        case cursorDown:
+        case cursorRight:
+        case cursorUp:
+        case cursorLeft:
+        case cursorHome:
+        case backspaceChar:
+        case insertChar:
+        case clearScreen:
+        case reverseModeOn:
+        case reverseModeOff:
+        case textColor0_Black:
+        case textColor1_White:
+        case textColor2_Red:
+        case textColor3_Cyan:
+        case textColor4_Purple:
+        case textColor5_Green:
+        case textColor6_Blue:
+        case textColor7_Yellow:
+        case textColor8_Orange:
+        case textColor9_Brown:
+        case textColor10_Light_Red:
+        case textColor11_Dark_Gray:
+        case textColor12_Medium_Gray:
+        case textColor13_Light_Green:
+        case textColor14_Light_Blue:
+        case textColor15_Light_Gray: return true;
+        }
+        return false;
+    }
+
     static uint8_t charForColor(uint8_t color) {
         color = color & 0x0f;
         switch (color) {
@@ -3,6 +3,7 @@
 // https://www.masswerk.at/6502/6502_instruction_set.html
 
 #include "cpu-6502.h"
+#include <array>
 #include <functional>
 #include <map>
 #include <cstring>
@@ -20,8 +21,9 @@ void CPU6502::reset() {
 }
 
 bool CPU6502::sys(uint16_t address) {
-    RAM[0x01FF] = 0x08; // High byte of 0x080C
-    RAM[0x01FE] = 0x0C; // Low byte of 0x080C
+    // RTS returns to 0x080C, where executeNext() gives control back to BASIC
+    RAM[0x01FF] = 0x08; // High byte of 0x080B
+    RAM[0x01FE] = 0x0B; // Low byte of 0x080B
     SP          = 0xFD; // Stack pointer (points to last used position)
     setPC(address);
     return true;
@@ -395,8 +397,8 @@ const char* OpCodeName(uint8_t op) {
 }
 
 const char* kernalRoutineName(uint16_t PC) {
-    static std::map<uint16_t, std::string> jt;
-    if (jt.empty()) {
+    static const std::map<uint16_t, std::string> jt = [] {
+        std::map<uint16_t, std::string> jt;
         jt[0x0073] = "BASIC_GET_NEXT_TEXT_CHARACTER";
 
         // $A000...$BFFF BASIC
@@ -493,17 +495,20 @@ const char* kernalRoutineName(uint16_t PC) {
         jt[0xFFED] = "SCREEN"; // return screen organisation
         jt[0xFFF0] = "PLOT"; // read/set cursor X/Y position
         jt[0xFFF3] = "IOBASE"; // return IOBASE address
-    }
-    if (jt.find(PC) != jt.end()) {
-        return jt[PC].c_str();
+        return jt;
+    }();
+    auto it = jt.find(PC);
+    if (it != jt.end()) {
+        return it->second.c_str();
     }
     return nullptr;
 }
 
 
 const CPU6502::OpCodeInfo& CPU6502::getOpcodeInfo(uint8_t op) {
-    static CPU6502::OpCodeInfo info[256] = {};
-    if (info[0].mnemonic == nullptr || info[0].length != 1) {
+    // built once, thread safe
+    static const std::array<CPU6502::OpCodeInfo, 256> info = [] {
+        std::array<CPU6502::OpCodeInfo, 256> info = {};
         auto add = [&](int op, const char* mn, AddrMode ops, int c, int cycles) {
             auto& iop    = info[op];
             iop.mnemonic = mn;
@@ -668,7 +673,8 @@ const CPU6502::OpCodeInfo& CPU6502::getOpcodeInfo(uint8_t op) {
                 add(i, "???", INVALID, 1, 1);
             }
         }
-    }
+        return info;
+    }();
     return info[op & 0xff];
 }
 
@@ -779,13 +785,14 @@ bool CPU6502::executeNext() {
     }
 
     // pre C++20 versions (no template, but costly)
-    // static auto executeOp = [this]<typename Op>(AddrMode mode, Op&& op) ;
-    // static auto executeRMW = [this](AddrMode mode, std::function<uint8_t(uint8_t)> op) ;
-    static auto executeOp = [this]<typename Op>(AddrMode mode, Op&& op) {
+    // auto executeOp = [this]<typename Op>(AddrMode mode, Op&& op) ;
+    // auto executeRMW = [this](AddrMode mode, std::function<uint8_t(uint8_t)> op) ;
+    // Not static: the lambdas capture this CPU.
+    auto executeOp = [this]<typename Op>(AddrMode mode, Op&& op) {
         op(fetchOperand(mode));
     };
 
-    static auto executeRMW = [this]<typename Op>(AddrMode mode, Op&& op) {
+    auto executeRMW = [this]<typename Op>(AddrMode mode, Op&& op) {
         if (mode == IMM) {
             return; // Not used for RMW
         }
@@ -804,20 +811,20 @@ bool CPU6502::executeNext() {
         }
     };
 
-    static auto AND = [this](uint8_t value) {
+    auto AND = [this](uint8_t value) {
         A &= value;
         setZN(A);
     };
 
-    static auto ORA = [this](uint8_t value) {
+    auto ORA = [this](uint8_t value) {
         A |= value;
         setZN(A);
     };
-    static auto EOR = [this](uint8_t value) {
+    auto EOR = [this](uint8_t value) {
         A ^= value;
         setZN(A);
     };
-    static auto ADC = [this](uint8_t value) {
+    auto ADC = [this](uint8_t value) {
         uint16_t sum = A + value + (P & PF_CARRY ? 1 : 0);
 
         // Overflow is always binary
@@ -843,7 +850,7 @@ bool CPU6502::executeNext() {
 
         setZN(A);
     };
-    static auto SBC = [this](uint8_t value) {
+    auto SBC = [this](uint8_t value) {
         uint16_t diff = A - value - (P & PF_CARRY ? 0 : 1);
 
         // Overflow is always binary
@@ -869,47 +876,47 @@ bool CPU6502::executeNext() {
 
         setZN(A);
     };
-    static auto CMP = [this](uint8_t value) {
+    auto CMP = [this](uint8_t value) {
         uint8_t result = A - value;
         setFlag(PF_CARRY, A >= value);
         setFlag(PF_ZERO, result == 0);
         setFlag(PF_NEGATIVE, result & 0x80);
     };
-    static auto CPX = [this](uint8_t value) {
+    auto CPX = [this](uint8_t value) {
         uint8_t result = X - value;
         setFlag(PF_CARRY, X >= value);
         setFlag(PF_ZERO, result == 0);
         setFlag(PF_NEGATIVE, result & 0x80);
     };
 
-    static auto CPY = [this](uint8_t value) {
+    auto CPY = [this](uint8_t value) {
         uint8_t result = Y - value;
         setFlag(PF_CARRY, Y >= value);
         setFlag(PF_ZERO, result == 0);
         setFlag(PF_NEGATIVE, result & 0x80);
     };
 
-    static auto ASL = [this](uint8_t value) -> uint8_t {
+    auto ASL = [this](uint8_t value) -> uint8_t {
         setFlag(PF_CARRY, value & 0x80);
         value <<= 1;
         setZN(value);
         return value;
     };
 
-    static auto LSR = [this](uint8_t value) -> uint8_t {
+    auto LSR = [this](uint8_t value) -> uint8_t {
         setFlag(PF_CARRY, value & 0x01);
         value >>= 1;
         setZN(value);
         return value;
     };
-    static auto ROL = [this](uint8_t value) -> uint8_t {
+    auto ROL = [this](uint8_t value) -> uint8_t {
         uint8_t oldCarry = (P & PF_CARRY) ? 1 : 0;
         setFlag(PF_CARRY, value & 0x80);
         value = (value << 1) | oldCarry;
         setZN(value);
         return value;
     };
-    static auto ROR = [this](uint8_t value) -> uint8_t {
+    auto ROR = [this](uint8_t value) -> uint8_t {
         uint8_t oldCarry = (P & PF_CARRY) ? 0x80 : 0;
         setFlag(PF_CARRY, value & 0x01);
         value = (value >> 1) | oldCarry;
@@ -917,15 +924,15 @@ bool CPU6502::executeNext() {
         return value;
     };
 
-    static auto LDA = [this](uint8_t value) {
+    auto LDA = [this](uint8_t value) {
         A = value;
         setZN(value);
     };
-    static auto LDX = [this](uint8_t value) {
+    auto LDX = [this](uint8_t value) {
         X = value;
         setZN(value);
     };
-    static auto LDY = [this](uint8_t value) {
+    auto LDY = [this](uint8_t value) {
         Y = value;
         setZN(value);
     };
@@ -1720,8 +1727,7 @@ int16_t CPU6502::assemble(const char* line, int16_t addr) {
 
 
 std::string CPU6502::registers() {
-    static char buf[256];
-    memset(buf, 0, sizeof(buf));
+    char buf[256] = {};
 
     sprintf(buf, "PC:%.4X   A:%.2X X:%.2X Y:%.2X   P:%.2X SP:%.2X",
             int(PC),
@@ -1831,16 +1837,15 @@ redo:
 
 
 void CPU6502::updateBasicHeatmap() {
-    static uint16_t lastLine = 0;
-    uint16_t currentLine     = RAM[0x39] | (RAM[0x3A] << 8);
+    uint16_t currentLine = RAM[0x39] | (RAM[0x3A] << 8);
 
-    if (currentLine != lastLine) {
+    if (currentLine != heatmapLine) {
         // attribute elapsed cycles to previous line
-        if (lastLine != 0) {
-            heatmap[lastLine] += (cycleCount - lastCycleSnapshot);
+        if (heatmapLine != 0) {
+            heatmap[heatmapLine] += (cycleCount - lastCycleSnapshot);
         }
 
-        lastLine          = currentLine;
+        heatmapLine       = currentLine;
         lastCycleSnapshot = cycleCount;
     }
 }
\ No newline at end of file
@@ -17,6 +17,7 @@ public:
 
     size_t cycleCount        = 0;
     size_t lastCycleSnapshot = 0;
+    uint16_t heatmapLine     = 0; // BASIC line of lastCycleSnapshot
     std::unordered_map<uint16_t, size_t> heatmap; // CPU cycles per BASIC line
 
 private:
@@ -1,14 +1,15 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
-// Simple, single-file C++17 implementation to parse and create .d64 images
+// Simple, single-file C++17 implementation to read and modify .d64 images
 // Supports standard 35-track, 174848-byte .d64 images.
 // Features:
-//  - Load .d64 into D64 structure (disk name + files with data and type)
-//  - Write D64 structure back to a .d64 image
-//  - Command-line helpers: "extract" to dump files from .d64 to a folder,
-//    and "pack" to create a .d64 from a folder of files (extension .prg => PRG)
+//  - Load .d64 into a sector cache and parse the directory (disk name + file entries)
+//  - Stream a file's sector chain without extracting all files
+//  - Write/scratch files in place: sectors are allocated through the BAM and
+//    only the touched sectors are written back to the image file
 // Notes / limitations:
 //  - PETSCII handling is basic: assumes filenames in directory are ASCII-compatible
 //    and trims padding (0xA0). Full PETSCII transliteration is not implemented.
@@ -25,21 +26,44 @@ public:
                               USR = 0x83,
                               REL = 0x84,
                               DEL = 0x00 };
+    // directory entry. The data stays in the image and is read on demand.
     struct FILE {
         std::string name; // Utf-8 file name
-        std::vector<uint8_t> data; // raw bytes
-        FileType type = PRG;
+        FileType type  = PRG;
+        uint8_t track  = 0; // first data sector
+        uint8_t sector = 0;
+        size_t size    = 0; // bytes in the sector chain
+        uint8_t dirTrack = 0, dirSector = 0, dirSlot = 0; // where the entry lives
     };
     std::vector<FILE> files;
 
     void clear();
+    void format(std::string name); // blank image in the cache, not bound to a path
     bool load(std::string path);
-    bool save(std::string path) const;
+    bool save(std::string path) const; // writes the whole image
+    bool flush(); // writes the modified sectors back to the loaded image file
+    const std::string& path() const { return imagePath; }
+
+    const FILE* findFile(const std::string& filename) const;
+    bool readFile(const std::string& filename, const std::function<void(const uint8_t* bytes, size_t count)>& sink) const;
+    bool readFile(const std::string& filename, std::vector<uint8_t>& data) const;
+    bool writeFile(const std::string& filename, const std::vector<uint8_t>& data, FileType type = PRG);
     bool removeFile(std::string filename);
-    void removeDelFiles();
 
 private:
     Os* os = nullptr;
-    bool load_d64_from_image(const std::vector<uint8_t>& img);
-    std::vector<uint8_t> save_d64_to_image() const;
+    std::string imagePath;
+    std::vector<uint8_t> image; // sector cache of the whole image
+    std::vector<bool> dirty; // per linear sector index
+
+    uint8_t* sectorData(int track, int sector);
+    const uint8_t* sectorData(int track, int sector) const;
+    void markDirty(int track, int sector);
+    bool isFree(int track, int sector) const;
+    void setFree(int track, int sector, bool free);
+    bool allocateSector(int& track, int& sector, bool directoryTrack);
+    void freeChain(int track, int sector);
+    bool findDirectorySlot(int& track, int& sector, int& slot);
+    void readDirectory();
+    void readFile(const FILE& f, const std::function<void(const uint8_t* bytes, size_t count)>* sink, size_t& size) const;
 };
@@ -50,24 +50,21 @@ bool FilePtr::close() {
 
     if (!d64FileName.empty() && !localTempPath.empty()) {
         if (dirty) {
-            D64 d64;
-            d64.init(os);
-            d64.load(d64FileName);
+            D64& d64 = os->D64Img;
+            if (d64.path() != d64FileName) {
+                d64.load(d64FileName);
+            }
 
-            D64::FILE file;
             // lowercase is PETSCII garbage
-            file.name = Unicode::toUpperAscii(Unicode::toAscii(cloudFileName.c_str(), '\0').c_str());
+            std::string name = Unicode::toUpperAscii(Unicode::toAscii(cloudFileName.c_str(), '\0').c_str());
 
             FilePtr loc(os);
             loc.fopenLocal(localTempPath, "rb");
-            file.data = loc.readAll();
+            auto data = loc.readAll();
             loc.close();
-            file.type = D64::PRG;
 
-            d64.removeDelFiles();
-            d64.removeFile(file.name);
-            d64.files.emplace_back(std::move(file));
-            rv = d64.save(d64FileName);
+            // only the touched sectors are written back
+            rv = d64.writeFile(name, data, D64::PRG) && d64.flush();
         }
 
     } else if (!cloudFileName.empty() && !localTempPath.empty()) {
@@ -152,14 +149,20 @@ bool FilePtr::open(std::string filenameUtf8, const char* mode) {
 
     close();
 
-    if (Serial::isSerialPath(filenameUtf8)) {
+    if (Serial::isSerialPath(filenameUtf8) && !os->localPath(filenameUtf8).empty()) {
         serial = new Serial();
         return serial->open(filenameUtf8);
     }
 
 
     // must be extracted from cloud or D64?
-    if (!isAbsolutePath(filenameUtf8) && (os->currentDir == Os::IsCloud || os->currentDir == Os::IsD64)) {
+    if (isAbsolutePath(filenameUtf8) || (os->currentDir != Os::IsCloud && os->currentDir != Os::IsD64)) {
+        filenameUtf8 = os->localPath(filenameUtf8);
+        if (filenameUtf8.empty()) {
+            lastStatus = "PATH NOT ALLOWED";
+            return false;
+        }
+    } else {
         // extract data and write to a temporary file
         cloudFileName = filenameUtf8;
         localTempPath = FilePtr::tempFileName();
@@ -192,23 +195,23 @@ bool FilePtr::open(std::string filenameUtf8, const char* mode) {
                     bytes     = resp.bytes;
                 }
             } else if (os->currentDir == Os::IsD64) {
-                D64 d64 {};
-                d64.init(os);
-                os->currentDir = Os::IsLocal; // avoid recursion
-                loadWasOK      = d64.load(d64FileName);
-                os->currentDir = Os::Os::IsD64;
-
-                if (loadWasOK) {
-                    d64.removeDelFiles();
-
-                    loadWasOK = false;
-                    for (auto& f : d64.files) {
-                        if (f.name == cloudFileName) {
-                            loadWasOK = true;
-                            bytes     = f.data;
-                        }
-                    }
+                D64& d64 = os->D64Img;
+                if (d64.path() != d64FileName) {
+                    os->currentDir = Os::IsLocal; // avoid recursion
+                    d64.load(d64FileName);
+                    os->currentDir = Os::IsD64;
                 }
+
+                // stream the sector chain straight into the temp file
+                FilePtr ftmp(os);
+                if (d64.findFile(cloudFileName) != nullptr && ftmp.fopenLocal(filenameUtf8, "wb")) {
+                    d64.readFile(cloudFileName, [&ftmp](const uint8_t* data, size_t count) {
+                        ftmp.write(data, count);
+                    });
+                    ftmp.close();
+                    return this->fopenLocal(filenameUtf8, mode);
+                }
+                return false;
             }
 
             // write file contents to temp local file
@@ -511,6 +514,20 @@ bool FilePtr::fopenLocal(std::string filenameUtf8, const char* mode) {
         file = ::_wfsopen(reinterpret_cast<const wchar_t*>(u16.c_str()), L"wb", _SH_DENYNO); // allow shared reading - even if some editor has the file open
 #else
         file = std::fopen(filenameUtf8.c_str(), "wb");
+#endif
+        if (!file) {
+            lastStatus = "CAN'T OPEN FOR WRITING";
+            return false;
+        }
+    } else if (mode[0] == 'r' && mode[1] == '+') {
+        // read and write in place, no truncation
+        isWriting = true;
+#ifdef _WIN32
+        std::u16string u16;
+        Unicode::toU16String(filenameUtf8.c_str(), u16);
+        file = ::_wfsopen(reinterpret_cast<const wchar_t*>(u16.c_str()), L"r+b", _SH_DENYNO);
+#else
+        file = std::fopen(filenameUtf8.c_str(), "r+b");
 #endif
         if (!file) {
             lastStatus = "CAN'T OPEN FOR WRITING";
@@ -533,7 +550,7 @@ bool FilePtr::fopenLocal(std::string filenameUtf8, const char* mode) {
         if (!file) {
             lastStatus = "UNSUPPORTED MODE";
         }
-        throw std::runtime_error("FilePtr::open - only r and w supported");
+        throw std::runtime_error("FilePtr::open - only r, r+ and w supported");
     }
     return true;
 }
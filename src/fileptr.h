@@ -77,6 +77,7 @@ public:
     size_t write(const void* buffer, size_t bytes);
     std::vector<uint8_t> readAll();
     std::string status() const { return lastStatus; }
+    IPC* ipcConnection() const { return ipc; } // nullptr if not opened with openIPC
 
     // static
     static std::string tempFileName();
@@ -1,6 +1,9 @@
 #include "font.h"
 #include "screen_buffer.h"
+#include <algorithm>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include "unicode.h"
 #include "petscii.h"
 
@@ -159,54 +162,71 @@ static void fillPetCatMap(std::unordered_map<std::string, char32_t>& petcatMap)
     petcatMap["{space}"]        = U' ';
 }
 
-static int my_strnicmp(const char* s1, const char* s2, size_t n) {
-    unsigned char c1, c2;
-
-    while (n-- > 0) {
-        c1 = *s1++;
-        c2 = *s2++;
-
-        // Convert both characters to lowercase manually
-        if (c1 >= 'A' && c1 <= 'Z') {
-            c1 += 'a' - 'A';
-        }
-        if (c2 >= 'A' && c2 <= 'Z') {
-            c2 += 'a' - 'A';
-        }
-
-        if (c1 != c2) {
-            return c1 - c2;
+// {name} -> code point. Sorted by the lower case name for a binary search.
+struct PetcatName {
+    std::string name; // lower case, with braces
+    char32_t codePoint;
+};
+
+static std::vector<PetcatName> buildPetcatNames() {
+    std::unordered_map<std::string, char32_t> petcatMap;
+    fillPetCatMap(petcatMap);
+
+    std::vector<PetcatName> names;
+    names.reserve(petcatMap.size());
+    for (auto& mp : petcatMap) {
+        // the parser only looks up "{...}". The others never matched.
+        if (mp.first.size() < 2 || mp.first.front() != '{' || mp.first.back() != '}') {
+            continue;
         }
-        if (c1 == '\0') {
-            return 0;
+        std::string lower = mp.first;
+        for (char& c : lower) {
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
         }
+        names.push_back({ lower, mp.second });
     }
-
-    return 0;
+    std::sort(names.begin(), names.end(), [](const PetcatName& a, const PetcatName& b) { return a.name < b.name; });
+    names.erase(std::unique(names.begin(), names.end(), [](const PetcatName& a, const PetcatName& b) { return a.name == b.name; }), names.end());
+    return names;
 }
+static const std::vector<PetcatName> petcatNames = buildPetcatNames();
 
 // parse the next character and escape the petcat {$xx} strings
 // return Unicode representation
 char32_t parseNextPetcat(const char*& str) {
-    static std::unordered_map<std::string, char32_t> petcatMap;
-    if (petcatMap.empty()) {
-        fillPetCatMap(petcatMap);
-    }
-
     if (*str == '{') {
-        for (auto mp : petcatMap) {
-            size_t len = mp.first.length();
-            if (my_strnicmp(str, mp.first.c_str(), len) == 0) {
-                str += len;
-                return mp.second;
+        // names never contain '}', so the whole {...} is the key
+        char key[32];
+        size_t len     = 0;
+        const char* pc = str;
+        while (*pc != '\0' && len < sizeof(key)) {
+            char c = *pc++;
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            key[len++] = c;
+            if (c == '}') {
+                break;
             }
         }
+
+        std::string_view name(key, len);
+        auto it = std::lower_bound(petcatNames.begin(), petcatNames.end(), name, [](const PetcatName& a, std::string_view b) { return a.name < b; });
+        if (it != petcatNames.end() && it->name == name) {
+            str += len;
+            return it->codePoint;
+        }
 #if _DEBUG
         *(int*)0 = 0;
 #endif
         while (*str != '}' && *str != '\0') {
             ++str;
         }
+        if (*str == '}') {
+            ++str;
+        }
         return U'?';
     }
 
@@ -2,12 +2,13 @@
 
 #include <map>
 std::string Help::getUsage(const std::string& command) {
-    static std::map<std::string, std::string> allHelp = {
+    static const std::map<std::string, std::string> allHelp = {
 #include "help.inc"
     };
 
-    if (allHelp.find(command) == allHelp.end()) {
+    auto it = allHelp.find(command);
+    if (it == allHelp.end()) {
         return "NO HELP AVAILABLE";
     }
-    return "*** " + command + " ***\n" + allHelp[command];
+    return "*** " + command + " ***\n" + it->second;
 }
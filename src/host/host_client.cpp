@@ -0,0 +1,119 @@
+#include "host_client.h"
+#include "host_protocol.h"
+#include "os.h"
+#include "unicode.h"
+#include <chrono>
+
+bool HostClient::connect(const std::string& address, int port, const std::string& sessionName, const std::string& token) {
+    close();
+    socket = HostSocket::connectTo(address, port);
+    if (socket == HostSocket::invalid) {
+        return false;
+    }
+    std::string frame;
+    HostProtocol::appendFrame(frame, HostProtocol::Frame::HELLO, token.empty() ? sessionName : sessionName + " " + token);
+    return HostSocket::send(socket, frame.data(), frame.size()) == long(frame.size());
+}
+
+void HostClient::close() {
+    HostSocket::close(socket);
+    received.clear();
+}
+
+void HostClient::sendKeys(const std::string& payload) {
+    std::string frame;
+    HostProtocol::appendFrame(frame, HostProtocol::Frame::KEYS, payload);
+    for (size_t sent = 0; sent < frame.size() && connected();) {
+        long n = HostSocket::send(socket, frame.data() + sent, frame.size() - sent);
+        if (n < 0) {
+            close();
+        }
+        sent += size_t(n > 0 ? n : 0);
+    }
+}
+
+void HostClient::type(const std::string& utf8) {
+    std::string payload;
+    const char* p = utf8.c_str();
+    for (char32_t c = Unicode::parseNextUtf8(p); c != 0; c = Unicode::parseNextUtf8(p)) {
+        if (c == U'\n') {
+            HostProtocol::putU32(payload, uint32_t(Os::KeyConstant::RETURN));
+            payload += char(0);
+        } else {
+            HostProtocol::putU32(payload, uint32_t(c));
+            payload += char(HostProtocol::PRINTABLE);
+        }
+    }
+    sendKeys(payload);
+}
+
+void HostClient::pressEscape() {
+    std::string payload;
+    HostProtocol::putU32(payload, uint32_t(Os::KeyConstant::ESCAPE));
+    payload += char(0);
+    sendKeys(payload);
+}
+
+void HostClient::receive(int timeoutMs) {
+    std::vector<HostSocket::PollEntry> entries { { socket, POLLIN, 0 } };
+    HostSocket::poll(entries, timeoutMs);
+
+    char buffer[4096];
+    long n;
+    while ((n = HostSocket::receive(socket, buffer, sizeof(buffer))) > 0) {
+        received.append(buffer, size_t(n));
+    }
+    if (n < 0) {
+        HostSocket::close(socket); // keep what was received
+    }
+
+    HostProtocol::Frame type;
+    std::string payload;
+    bool malformed = false;
+    while (HostProtocol::takeFrame(received, type, payload, malformed)) {
+        if (type == HostProtocol::Frame::NOTICE) {
+            notices += payload + "\n";
+        } else if (type == HostProtocol::Frame::TOKEN) {
+            token = payload;
+        } else if (type == HostProtocol::Frame::SCREEN && payload.size() >= 8) {
+            width  = HostProtocol::getU16(&payload[0]);
+            height = HostProtocol::getU16(&payload[2]);
+            chars.resize(width * height, U' ');
+            for (size_t i = 8; i + HostProtocol::screenRunHeader <= payload.size();) {
+                size_t offset = HostProtocol::getU32(&payload[i]);
+                size_t count  = HostProtocol::getU16(&payload[i + 4]);
+                i += HostProtocol::screenRunHeader;
+                for (size_t k = 0; k < count && i + HostProtocol::screenCellSize <= payload.size(); ++k, i += HostProtocol::screenCellSize) {
+                    if (offset + k < chars.size()) {
+                        chars[offset + k] = char32_t(HostProtocol::getU32(&payload[i]));
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool HostClient::waitFor(const std::string& text, int timeoutMs) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        if (screenText().find(text) != std::string::npos) {
+            return true;
+        }
+        if (!connected() || std::chrono::steady_clock::now() > end) {
+            return false;
+        }
+        receive(20);
+    }
+}
+
+std::string HostClient::screenText() const {
+    std::string text;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            char32_t c = chars[y * width + x];
+            Unicode::appendAsUtf8(text, c < 0x20 ? U' ' : c);
+        }
+        text += '\n';
+    }
+    return text;
+}
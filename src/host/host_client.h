@@ -0,0 +1,34 @@
+#pragma once
+#include "host_socket.h"
+#include <string>
+
+// A BA67host client that keeps a copy of the session's screen.
+// Used by BA67host --test.
+class HostClient {
+public:
+    ~HostClient() { close(); }
+
+    // token: empty for a new session, else the one the host sent for it
+    bool connect(const std::string& address, int port, const std::string& sessionName, const std::string& token = {});
+    void close();
+    bool connected() const { return socket != HostSocket::invalid; }
+
+    // types UTF-8 text. '\n' is the RETURN key.
+    void type(const std::string& utf8);
+    void pressEscape();
+
+    // receives frames until the screen shows text or the time is up
+    bool waitFor(const std::string& text, int timeoutMs);
+    std::string screenText() const; // the rows, separated by '\n'
+    std::string notices; // NOTICE texts, one per line
+    std::string token; // TOKEN of the last new session
+
+private:
+    HostSocket::Handle socket = HostSocket::invalid;
+    std::string received;
+    size_t width = 0, height = 0;
+    std::u32string chars;
+
+    void sendKeys(const std::string& payload);
+    void receive(int timeoutMs);
+};
@@ -0,0 +1,181 @@
+#include "host_client.h"
+#include "session_host.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// BA67host: BASIC sessions for many users in one process.
+// Each TCP client names a session. The sessions run on a pool of worker
+// threads and are saved to --state-dir when they sit idle at READY or
+// another session waits for a worker. Each session's files live in its own
+// folder under --state-dir. The first client of a name gets the session's
+// token, later clients must send it.
+
+static volatile std::sig_atomic_t stopSignal = 0;
+static void onStopSignal(int) { stopSignal = 1; }
+
+static void printHelp() {
+    printf("BA67host - BASIC sessions over TCP. www.ba67.org/\n");
+    printf("\n");
+    printf("--help                      show this help\n");
+    printf("--bind         127.0.0.1    (default) address to listen on\n");
+    printf("--port         6767         (default) TCP port\n");
+    printf("--threads      n            sessions running at the same time (default: CPU cores)\n");
+    printf("--cpu-share    percent      100 (default): a program may use a whole core\n");
+    printf("--cpu-limit    seconds      CPU time of one RUN before BREAK. 0 (default): no limit\n");
+    printf("--memory       MB           heap of one session, 64 (default). 0: no limit\n");
+    printf("--idle         seconds      save and stop a session idle at READY, 600 (default)\n");
+    printf("--state-dir    dir          where the sessions are saved and keep their files, sessions (default)\n");
+    printf("--test                      run the sessions self test over localhost and exit\n");
+    printf("\n");
+    printf("The first client of a session name gets a token. Only clients with it can resume the session.\n");
+}
+
+// starts a host on a free port and drives it with clients
+static int runSelfTest() {
+    HostLimits limits;
+    limits.threads        = 2;
+    limits.cpuLimitMs     = 1000;
+    limits.idleMs         = 500;
+    limits.stateDirectory = (std::filesystem::temp_directory_path() / "ba67host-test").string();
+    std::error_code ec;
+    std::filesystem::remove_all(limits.stateDirectory, ec);
+
+    SessionHost host;
+    if (!host.start(limits, "127.0.0.1", 0)) {
+        printf("FAIL cannot listen on localhost\n");
+        return 1;
+    }
+    int failures = 0;
+    auto check   = [&](bool ok, const std::string& what) {
+        printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+        fflush(stdout);
+        failures += ok ? 0 : 1;
+    };
+
+    // twice as many sessions as workers: the idle ones make room
+    std::vector<HostClient> pupils(4);
+    for (size_t i = 0; i < pupils.size(); ++i) {
+        check(pupils[i].connect("127.0.0.1", host.port(), "pupil-" + std::to_string(i)), "connect pupil-" + std::to_string(i));
+        pupils[i].type("PRINT " + std::to_string(1000 + i) + "*7\n");
+    }
+    for (size_t i = 0; i < pupils.size(); ++i) {
+        std::string expected = " " + std::to_string((1000 + i) * 7);
+        check(pupils[i].waitFor(expected, 10000), "pupil-" + std::to_string(i) + " prints" + expected);
+    }
+
+    // a suspended session keeps its program and variables. Files stay in its home.
+    HostClient keep;
+    keep.connect("127.0.0.1", host.port(), "keep");
+    keep.type("A=42:DIM B$():B$(\"K\")=\"V\"\n");
+    keep.type("10 PRINT \"KE\"+\"PT\"\n");
+    keep.type("SAVE \"../ESCAPE.BAS\"\nSAVE \"MINE.BAS\"\n");
+    check(keep.waitFor("10 PRINT", 10000), "keep types a program line");
+    keep.close();
+    for (int i = 0; i < 100 && host.stateOf("keep") != Session::State::SUSPENDED; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    check(host.stateOf("keep") == Session::State::SUSPENDED && std::filesystem::exists(std::filesystem::path(limits.stateDirectory) / "keep.state67"), "keep is saved after the client left");
+    check(std::filesystem::exists(std::filesystem::path(limits.stateDirectory) / "keep" / "MINE.BAS"), "keep saves into its home");
+    check(!std::filesystem::exists(std::filesystem::path(limits.stateDirectory) / "ESCAPE.BAS"), "keep cannot save outside its home");
+    HostClient thief;
+    thief.connect("127.0.0.1", host.port(), "keep", "0123");
+    check(!thief.waitFor("READY", 2000) && thief.notices.find("ANOTHER CLIENT") != std::string::npos, "keep cannot be resumed with a wrong token");
+    keep.connect("127.0.0.1", host.port(), "keep", keep.token);
+    keep.type("PRINT A;B$(\"K\")\n");
+    check(keep.waitFor(" 42 V", 10000), "keep has its variables after resuming");
+    keep.type("RUN\n");
+    check(keep.waitFor("KEPT", 10000), "keep runs the program after resuming");
+
+    // quotas
+    HostClient busy;
+    busy.connect("127.0.0.1", host.port(), "busy");
+    busy.type("10 GOTO 10\nRUN\n");
+    check(busy.waitFor("BREAK", 10000), "busy gets a BREAK after its CPU time");
+
+    HostClient greedy;
+    greedy.connect("127.0.0.1", host.port(), "greedy");
+    greedy.type("DIM A(20000000)\n");
+    check(greedy.waitFor("OUT OF MEMORY", 10000), "greedy runs out of its memory");
+
+    host.stop();
+    std::filesystem::remove_all(limits.stateDirectory, ec);
+
+    // one worker: a session at READY gives it up for a queued one long before idleMs
+    HostLimits single     = limits;
+    single.threads        = 1;
+    single.idleMs         = 60000;
+    single.stateDirectory = limits.stateDirectory + "-single";
+    SessionHost singleHost;
+    check(singleHost.start(single, "127.0.0.1", 0), "start a host with one worker");
+    HostClient first, second;
+    first.connect("127.0.0.1", singleHost.port(), "first");
+    first.type("PRINT 6*7\n");
+    check(first.waitFor(" 42", 10000), "first runs on the only worker");
+    second.connect("127.0.0.1", singleHost.port(), "second");
+    second.type("PRINT 6*8\n");
+    check(second.waitFor(" 48", 10000), "second gets the worker while first waits at READY");
+    first.type("PRINT 6*9\n");
+    check(first.waitFor(" 54", 10000), "first gets it back");
+    singleHost.stop();
+    std::filesystem::remove_all(single.stateDirectory, ec);
+    printf("%s\n", failures == 0 ? "ALL HOST TESTS PASSED" : "HOST TESTS FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv, argv + argc);
+    args.push_back(""); // ensure [i] and [i+1]
+
+    HostLimits limits;
+    limits.threads        = std::max(1, int(std::thread::hardware_concurrency()));
+    limits.stateDirectory = "sessions";
+    std::string address   = "127.0.0.1";
+    int port              = 6767;
+    for (size_t i = 1; i + 1 < args.size(); ++i) {
+        const std::string& value = args[i + 1];
+        if (args[i] == "--help") {
+            printHelp();
+            return 0;
+        } else if (args[i] == "--test") {
+            return runSelfTest();
+        } else if (args[i] == "--bind") {
+            address = value;
+        } else if (args[i] == "--port") {
+            port = atoi(value.c_str());
+        } else if (args[i] == "--threads") {
+            limits.threads = atoi(value.c_str());
+        } else if (args[i] == "--cpu-share") {
+            limits.cpuShare = std::clamp(atof(value.c_str()) / 100.0, 0.01, 1.0);
+        } else if (args[i] == "--cpu-limit") {
+            limits.cpuLimitMs = uint64_t(std::max(0.0, atof(value.c_str())) * 1000.0);
+        } else if (args[i] == "--memory") {
+            limits.memoryBytes = int64_t(std::max(0.0, atof(value.c_str())) * 1024.0 * 1024.0);
+        } else if (args[i] == "--idle") {
+            limits.idleMs = uint64_t(std::max(0.0, atof(value.c_str())) * 1000.0);
+        } else if (args[i] == "--state-dir") {
+            limits.stateDirectory = value;
+        }
+    }
+
+    SessionHost host;
+    if (!host.start(limits, address, port)) {
+        fprintf(stderr, "cannot listen on %s:%d\n", address.c_str(), port);
+        return 1;
+    }
+    printf("BA67host on %s:%d, %d workers\n", address.c_str(), host.port(), limits.threads);
+    fflush(stdout);
+
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    while (stopSignal == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    host.stop(); // saves every session
+    return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// BA67host wire protocol. One TCP connection per session.
+// Every message is a frame: type (1 byte), payload length (uint32), payload.
+// All numbers are little endian.
+//
+// client -> host
+//   HELLO   session name, UTF-8. Letters, digits, '-' and '_'. Sent once, first.
+//           To resume a session, a space and its TOKEN follow the name.
+//   KEYS    n * { uint32 code, uint8 flags } - Os::KeyPress, flags see KeyFlags
+// host -> client
+//   SCREEN  uint16 width, height, cursor x, cursor y, then changed runs:
+//           { uint32 offset, uint16 count, count * { uint32 char, uint8 color } }
+//           The first SCREEN after HELLO holds the whole screen.
+//   NOTICE  UTF-8 text about the session, e.g. waiting for a free worker
+//   TOKEN   the secret of a new session. Every later HELLO for it must send it.
+namespace HostProtocol {
+    enum class Frame : uint8_t { HELLO  = 1,
+                                 KEYS   = 2,
+                                 SCREEN = 16,
+                                 NOTICE = 17,
+                                 TOKEN  = 18 };
+
+    enum KeyFlags : uint8_t { PRINTABLE = 1,
+                              SHIFT     = 2,
+                              ALT       = 4,
+                              CTRL      = 8 };
+
+    constexpr size_t headerSize      = 5;
+    constexpr size_t maxPayloadSize  = 1024 * 1024; // larger frames close the connection
+    constexpr size_t maxSessionName  = 32;
+    constexpr size_t tokenLength     = 32; // hex digits
+    constexpr size_t keySize         = 5; // uint32 code, uint8 flags
+    constexpr size_t screenCellSize  = 5; // uint32 char, uint8 color
+    constexpr size_t screenRunHeader = 6; // uint32 offset, uint16 count
+
+    inline void putU16(std::string& out, uint16_t v) {
+        out += char(v & 0xff);
+        out += char(v >> 8);
+    }
+    inline void putU32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 32; i += 8) {
+            out += char((v >> i) & 0xff);
+        }
+    }
+    inline uint16_t getU16(const char* p) {
+        return uint16_t(uint8_t(p[0]) | (uint8_t(p[1]) << 8));
+    }
+    inline uint32_t getU32(const char* p) {
+        return uint32_t(uint8_t(p[0])) | (uint32_t(uint8_t(p[1])) << 8) | (uint32_t(uint8_t(p[2])) << 16) | (uint32_t(uint8_t(p[3])) << 24);
+    }
+
+    inline void appendFrame(std::string& out, Frame type, std::string_view payload) {
+        out += char(type);
+        putU32(out, uint32_t(payload.size()));
+        out += payload;
+    }
+
+    // takes the next complete frame off the front of buffer.
+    // false if it is not complete yet. malformed is set for oversized frames.
+    inline bool takeFrame(std::string& buffer, Frame& type, std::string& payload, bool& malformed) {
+        malformed = false;
+        if (buffer.size() < headerSize) {
+            return false;
+        }
+        size_t length = getU32(&buffer[1]);
+        if (length > maxPayloadSize) {
+            malformed = true;
+            return false;
+        }
+        if (buffer.size() < headerSize + length) {
+            return false;
+        }
+        type = Frame(uint8_t(buffer[0]));
+        payload.assign(buffer, headerSize, length);
+        buffer.erase(0, headerSize + length);
+        return true;
+    }
+
+    inline bool isValidSessionName(std::string_view name) {
+        if (name.empty() || name.size() > maxSessionName) {
+            return false;
+        }
+        for (char c : name) {
+            bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace HostProtocol
@@ -0,0 +1,144 @@
+#include "host_socket.h"
+#include <cstring>
+
+#ifdef _WIN32
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <arpa/inet.h>
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace HostSocket {
+
+    static bool wouldBlock() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    static void setNonBlocking(Handle s) {
+#ifdef _WIN32
+        u_long on = 1;
+        ioctlsocket(s, FIONBIO, &on);
+#else
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+        // keystrokes and screen diffs are small. Send them at once.
+        int on = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+    }
+
+    bool startup() {
+#ifdef _WIN32
+        WSADATA wsa;
+        return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+        return true;
+#endif
+    }
+
+    Handle listenOn(const std::string& address, int port, int& boundPort) {
+        Handle s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == invalid) {
+            return invalid;
+        }
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port   = htons(uint16_t(port));
+        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1
+            || ::bind(s, (sockaddr*)&addr, sizeof(addr)) != 0
+            || ::listen(s, 64) != 0) {
+            close(s);
+            return invalid;
+        }
+
+        socklen_t length = sizeof(addr);
+        getsockname(s, (sockaddr*)&addr, &length);
+        boundPort = ntohs(addr.sin_port);
+        setNonBlocking(s);
+        return s;
+    }
+
+    Handle accept(Handle listener) {
+        Handle s = ::accept(listener, nullptr, nullptr);
+        if (s != invalid) {
+            setNonBlocking(s);
+        }
+        return s;
+    }
+
+    Handle connectTo(const std::string& address, int port) {
+        addrinfo hints {};
+        hints.ai_family   = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found   = nullptr;
+        if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+            return invalid;
+        }
+        Handle s = ::socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+        if (s != invalid && ::connect(s, found->ai_addr, int(found->ai_addrlen)) != 0) {
+            close(s);
+        }
+        freeaddrinfo(found);
+        if (s != invalid) {
+            setNonBlocking(s);
+        }
+        return s;
+    }
+
+    void close(Handle& s) {
+        if (s == invalid) {
+            return;
+        }
+#ifdef _WIN32
+        closesocket(s);
+#else
+        ::close(s);
+#endif
+        s = invalid;
+    }
+
+    long send(Handle s, const char* data, size_t size) {
+#ifdef _WIN32
+        long n = ::send(s, data, int(size), 0);
+#else
+        long n = long(::send(s, data, size, MSG_NOSIGNAL));
+#endif
+        if (n < 0) {
+            return wouldBlock() ? 0 : -1;
+        }
+        return n;
+    }
+
+    long receive(Handle s, char* data, size_t size) {
+#ifdef _WIN32
+        long n = ::recv(s, data, int(size), 0);
+#else
+        long n = long(::recv(s, data, size, 0));
+#endif
+        if (n < 0) {
+            return wouldBlock() ? 0 : -1;
+        }
+        return n == 0 ? -1 : n; // 0: the peer closed the connection
+    }
+
+    bool poll(std::vector<PollEntry>& entries, int timeoutMs) {
+#ifdef _WIN32
+        return WSAPoll(entries.data(), ULONG(entries.size()), timeoutMs) >= 0;
+#else
+        return ::poll(entries.data(), nfds_t(entries.size()), timeoutMs) >= 0 || errno == EINTR;
+#endif
+    }
+} // namespace HostSocket
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <winsock2.h>
+#else
+    #include <poll.h>
+#endif
+
+// the few non-blocking TCP calls BA67host needs, for winsock and POSIX
+namespace HostSocket {
+#ifdef _WIN32
+    using Handle = SOCKET;
+    constexpr Handle invalid = INVALID_SOCKET;
+    using PollEntry          = WSAPOLLFD;
+#else
+    using Handle             = int;
+    constexpr Handle invalid = -1;
+    using PollEntry          = pollfd;
+#endif
+
+    bool startup();
+
+    // listening socket. port 0 picks a free port, boundPort tells which.
+    Handle listenOn(const std::string& address, int port, int& boundPort);
+    Handle accept(Handle listener);
+    // blocking connect, then switched to non-blocking
+    Handle connectTo(const std::string& address, int port);
+    void close(Handle& s);
+
+    // >0 bytes moved, 0 would block, -1 closed or failed
+    long send(Handle s, const char* data, size_t size);
+    long receive(Handle s, char* data, size_t size);
+
+    // waits for the events in entries. Returns false on errors.
+    bool poll(std::vector<PollEntry>& entries, int timeoutMs);
+} // namespace HostSocket
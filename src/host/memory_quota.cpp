@@ -0,0 +1,77 @@
+#include "memory_quota.h"
+#include <cstdlib>
+#include <new>
+
+namespace MemoryQuota {
+    static thread_local Account* current = nullptr;
+
+    Account* threadAccount() { return current; }
+
+    Account& newAccount() {
+        Scope uncounted(nullptr);
+        return *new Account();
+    }
+
+    Scope::Scope(Account* account)
+        : previous(current) {
+        current = account;
+    }
+    Scope::~Scope() { current = previous; }
+} // namespace MemoryQuota
+
+// A header in front of every block. 16 bytes keep the default new alignment.
+struct alignas(16) BlockHeader {
+    MemoryQuota::Account* account;
+    size_t size;
+};
+
+static void* allocate(size_t size) {
+    MemoryQuota::Account* account = MemoryQuota::current;
+    if (account != nullptr) {
+        int64_t used  = account->bytes.fetch_add(int64_t(size)) + int64_t(size);
+        int64_t limit = account->limit;
+        if (limit != 0 && used > limit) {
+            account->bytes -= int64_t(size);
+            return nullptr;
+        }
+    }
+    auto* block = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+    if (block == nullptr) {
+        if (account != nullptr) {
+            account->bytes -= int64_t(size);
+        }
+        return nullptr;
+    }
+    block->account = account;
+    block->size    = size;
+    return block + 1;
+}
+
+static void release(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    BlockHeader* block = static_cast<BlockHeader*>(p) - 1;
+    if (block->account != nullptr) {
+        block->account->bytes -= int64_t(block->size);
+    }
+    std::free(block);
+}
+
+void* operator new(size_t size) {
+    void* p = allocate(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size == 0 ? 1 : size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size == 0 ? 1 : size); }
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// BA67host replaces operator new/delete to count the heap of each session.
+// Every block remembers the account it was charged to, so it is credited
+// back there, no matter which thread frees it.
+namespace MemoryQuota {
+    struct Account {
+        std::atomic<int64_t> bytes { 0 };
+        std::atomic<int64_t> limit { 0 }; // 0 = unlimited. new throws std::bad_alloc above it.
+    };
+
+    // Accounts are never freed. Static data that a session built lazily,
+    // like a lookup table, is freed at exit - after the Session.
+    Account& newAccount();
+
+    // the account of the allocations of this thread. nullptr: not counted
+    Account* threadAccount();
+
+    // charges the allocations of this thread to an account while in scope
+    class Scope {
+    public:
+        explicit Scope(Account* account);
+        ~Scope();
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Account* previous;
+    };
+} // namespace MemoryQuota
@@ -0,0 +1,272 @@
+#include "os_session.h"
+#include "basic.h"
+#include "host_protocol.h"
+#include "session_host.h"
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+static constexpr uint64_t frameIntervalMs = 25; // at most 40 screen updates per second
+
+OsSession::OsSession(SessionHost& host, Session& session)
+    : host(host)
+    , session(session) {
+    home = host.homeDirectory(session);
+}
+
+bool OsSession::init(Basic* basic, SoundSystem* sound) {
+    Os::init(basic, sound);
+    screen.setSize(80, 25);
+    return true;
+}
+
+uint64_t OsSession::threadCpuNanoseconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    auto ticks = [](const FILETIME& t) { return (uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) * 100;
+#else
+    timespec t {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return uint64_t(t.tv_sec) * 1000000000ull + uint64_t(t.tv_nsec);
+#endif
+}
+
+uint64_t OsSession::tick() const {
+    return SessionHost::now();
+}
+
+void OsSession::delay(int ms) {
+    while (ms > 0) {
+        int slice = std::min(ms, 50);
+        std::this_thread::sleep_for(std::chrono::milliseconds(slice));
+        ms -= slice;
+        presentScreen();
+    }
+}
+
+void OsSession::updateEvents() {
+    if ((++eventCalls & 0xff) == 0) {
+        checkQuotas();
+    }
+}
+
+// a running program: BREAK when the host stops or the CPU time of the
+// command is used up. Sleep when it uses more than its share of a core.
+void OsSession::checkQuotas() {
+    if (basic == nullptr || basic->waitingAtPrompt) {
+        return;
+    }
+    if (host.stopping()) {
+        throw BA67::Error(BA67::ErrorId::BREAK);
+    }
+    const HostLimits& limits = host.limits();
+    uint64_t cpu             = threadCpuNanoseconds();
+    if (limits.cpuLimitMs != 0 && cpu - runCpuStart > limits.cpuLimitMs * 1000000ull) {
+        throw BA67::Error(BA67::ErrorId::BREAK);
+    }
+
+    if (limits.cpuShare < 1.0) {
+        uint64_t wall = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        if (wall - shareWindowStart > 100000000ull) { // a new 100 ms window
+            shareWindowStart = wall;
+            shareWindowCpu   = cpu;
+            return;
+        }
+        double used    = double(cpu - shareWindowCpu);
+        double elapsed = double(wall - shareWindowStart);
+        if (used > limits.cpuShare * elapsed) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(uint64_t(used / limits.cpuShare - elapsed)));
+        }
+    }
+}
+
+// the screen cells that changed since the last frame, in runs
+void OsSession::presentScreen() {
+    uint64_t t = tick();
+    if (t < nextFrameMs && !wholeScreen) {
+        return;
+    }
+    nextFrameMs = t + frameIntervalMs;
+    auto connection = host.connectionOf(session);
+    if (connection == nullptr) {
+        return;
+    }
+
+    ++frames;
+    ScopedNanoseconds frameTime(frameNanoseconds, &maxFrameNanoseconds);
+    MemoryQuota::Scope uncounted(nullptr); // the I/O thread frees the frame
+
+    auto state   = screen.saveState();
+    size_t cells = screen.width * screen.height;
+    if (wholeScreen.exchange(false) || sentChars.size() != cells) {
+        sentChars.assign(cells, uint32_t(-1));
+        sentColors.assign(cells, uint32_t(-1));
+        sentCursor = size_t(-1);
+    }
+    auto changed = [&](size_t i) { return state.chars[i] != sentChars[i] || (state.colr[i] & 0xff) != sentColors[i]; };
+
+    std::string payload;
+    HostProtocol::putU16(payload, uint16_t(screen.width));
+    HostProtocol::putU16(payload, uint16_t(screen.height));
+    HostProtocol::putU16(payload, uint16_t(state.crsr.x));
+    HostProtocol::putU16(payload, uint16_t(state.crsr.y));
+    size_t header = payload.size();
+    for (size_t i = 0; i < cells;) {
+        if (!changed(i)) {
+            ++i;
+            continue;
+        }
+        // a run ends after 4 unchanged cells. Sending a short gap is cheaper than a new run.
+        size_t end = i + 1;
+        for (size_t j = end; j < cells && j < end + 4; ++j) {
+            if (changed(j)) {
+                end = j + 1;
+            }
+        }
+        HostProtocol::putU32(payload, uint32_t(i));
+        HostProtocol::putU16(payload, uint16_t(end - i));
+        for (; i < end; ++i) {
+            sentChars[i]  = state.chars[i];
+            sentColors[i] = state.colr[i] & 0xff;
+            HostProtocol::putU32(payload, sentChars[i]);
+            payload += char(sentColors[i]);
+        }
+    }
+
+    size_t cursor = state.crsr.y * screen.width + state.crsr.x;
+    if (payload.size() == header && cursor == sentCursor) {
+        return;
+    }
+    sentCursor = cursor;
+    std::string frame;
+    HostProtocol::appendFrame(frame, HostProtocol::Frame::SCREEN, payload);
+    connection->send(frame);
+}
+
+const bool OsSession::isKeyPressed(char32_t index, bool withShift, bool withAlt, bool withCtrl) const {
+    if (index == char32_t(KeyConstant::ESCAPE)) {
+        return escapePressed.exchange(false);
+    }
+    return false;
+}
+
+void OsSession::typeKey(const KeyPress& key) {
+    if (key.code == char32_t(KeyConstant::ESCAPE)) {
+        escapePressed = true;
+        return;
+    }
+    putToKeyboardBuffer(key);
+}
+
+// Waiting at READY is where a session can be suspended: when its client is
+// gone, when nobody typed for HostLimits::idleMs, when the host stops or when
+// another session waits for a worker.
+// A program that waits for keys without a client gets a BREAK instead.
+Os::KeyPress OsSession::getFromKeyboardBuffer() {
+    uint64_t waitStart = SessionHost::now();
+    while (!keyboardBufferHasData()) {
+        bool attached = host.connectionOf(session) != nullptr;
+        uint64_t idle = SessionHost::now() - std::max(waitStart, session.lastInputMs.load());
+        if (basic->waitingAtPrompt) {
+            if (host.stopping() || !attached || idle > host.limits().idleMs) {
+                throw Suspend();
+            }
+            // give the worker to a queued session, unless that loses state
+            if (host.sessionsWaiting() && basic->unsavedState().empty()) {
+                throw Suspend();
+            }
+        } else if (host.stopping() || (!attached && idle > host.limits().idleMs)) {
+            throw BA67::Error(BA67::ErrorId::BREAK);
+        }
+        presentScreen();
+        basic->dumpStatsIfDue();
+        waitForKeyboard(50);
+    }
+
+    KeyPress key = Os::getFromKeyboardBuffer();
+    if (basic->waitingAtPrompt) {
+        runCpuStart = threadCpuNanoseconds(); // the CPU quota counts from the RETURN
+    }
+    return key;
+}
+
+size_t OsSession::getFreeMemoryInBytes() {
+    int64_t limit = session.memory.limit;
+    if (limit == 0) {
+        return Os::getFreeMemoryInBytes();
+    }
+    return size_t(std::max<int64_t>(0, limit - session.memory.bytes));
+}
+
+std::string OsSession::getHomeDirectory() {
+    return home;
+}
+
+std::string OsSession::getCurrentDirectory() {
+    if (dirIsInCloud() || dirIsInD64()) {
+        return Os::getCurrentDirectory();
+    }
+    return home;
+}
+
+// the process' working directory belongs to all sessions. It is never changed.
+bool OsSession::setCurrentDirectory(const std::string& dir) {
+    if (dir == "CLOUD") {
+        return Os::setCurrentDirectory(dir);
+    }
+    std::string local = localPath(dir);
+    if (local.empty()) {
+        return false;
+    }
+    if (dir.ends_with(".d64") || dir.ends_with(".D64")) {
+        return Os::setCurrentDirectory(local);
+    }
+    if (local == home) {
+        setCurrentDirectoryLocal();
+        return true;
+    }
+    return false;
+}
+
+// relative to the home. Absolute paths and ".." must not leave it.
+std::string OsSession::localPath(const std::string& pathUtf8) {
+    if (stateFileAccess) {
+        return pathUtf8;
+    }
+    if (pathUtf8.empty()) {
+        return {};
+    }
+    std::filesystem::path base(home);
+    std::filesystem::path path   = (base / pathUtf8).lexically_normal(); // home / an absolute path is the absolute path
+    std::filesystem::path inside = path.lexically_relative(base.lexically_normal());
+    if (inside.empty() || *inside.begin() == "..") {
+        return {};
+    }
+    return inside == "." ? home : path.string();
+}
+
+int OsSession::systemCall(const std::string& commandLineUtf8, bool printOutput) {
+    if (printOutput) {
+        basic->printUtf8String("SYSTEM CALLS ARE DISABLED ON THIS HOST\n");
+    }
+    return -1;
+}
+
+std::string OsSession::getEnv(const std::string& name) {
+    auto it = environment.find(name);
+    return it != environment.end() ? it->second : std::string();
+}
+
+void OsSession::setEnv(const std::string& name, const std::string& value) {
+    environment[name] = value;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "os.h"
+#include <atomic>
+#include <map>
+#include <vector>
+
+class Session;
+class SessionHost;
+
+// Headless backend of one BA67host session.
+// presentScreen sends the changed screen cells to the client, the I/O thread
+// types the client's keys. updateEvents enforces the CPU quota of the session.
+class OsSession : public Os {
+public:
+    // thrown out of Basic::runInterpreter when the session is suspended at READY
+    struct Suspend { };
+
+    OsSession(SessionHost& host, Session& session);
+    bool init(Basic* basic, SoundSystem* sound) override;
+    void updateEvents() override;
+
+    uint64_t tick() const override;
+    void delay(int ms) override;
+
+    void presentScreen() override;
+    void sendWholeScreen() { wholeScreen = true; }
+
+    const bool isKeyPressed(char32_t index, bool withShift = false, bool withAlt = false, bool withCtrl = false) const override;
+    KeyPress getFromKeyboardBuffer() override;
+    // I/O thread: a key from the client. ESC breaks like the ESC key of a window.
+    void typeKey(const KeyPress& key);
+
+    size_t getFreeMemoryInBytes() override;
+
+    // each session has its own home folder. Local files must lie inside it,
+    // CHDIR can only switch to the CLOUD and its D64 images and back.
+    std::string getHomeDirectory() override;
+    std::string getCurrentDirectory() override;
+    bool setCurrentDirectory(const std::string& dir) override;
+    std::string localPath(const std::string& pathUtf8) override;
+    bool stateFileAccess = false; // runSession loads and saves the state file outside the home
+    int systemCall(const std::string& commandLineUtf8, bool printOutput = true) override;
+
+    // per session, not the host's environment
+    std::string getEnv(const std::string& name) override;
+    void setEnv(const std::string& name, const std::string& value) override;
+
+    static uint64_t threadCpuNanoseconds();
+
+private:
+    SessionHost& host;
+    Session& session;
+    std::string home;
+    std::map<std::string, std::string> environment;
+
+    mutable std::atomic<bool> escapePressed = false; // until isKeyPressed(ESCAPE) saw it
+    std::atomic<bool> wholeScreen           = true;
+    uint64_t nextFrameMs                    = 0;
+    std::vector<uint32_t> sentChars, sentColors;
+    size_t sentCursor = size_t(-1);
+
+    uint32_t eventCalls       = 0; // updateEvents checks the quotas every 256 calls
+    uint64_t runCpuStart      = 0; // threadCpuNanoseconds when the last direct command started
+    uint64_t shareWindowStart = 0; // [ns] steady clock
+    uint64_t shareWindowCpu   = 0;
+    void checkQuotas();
+};
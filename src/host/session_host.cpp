@@ -0,0 +1,404 @@
+#include "session_host.h"
+#include "basic.h"
+#include "host_protocol.h"
+#include "os_session.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+void Connection::send(const std::string& frame) {
+    std::lock_guard<std::mutex> lock(outgoingMutex);
+    outgoing += frame;
+}
+
+uint64_t SessionHost::now() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool SessionHost::start(const HostLimits& limits, const std::string& address, int port) {
+    hostLimits = limits;
+    if (hostLimits.threads < 1) {
+        hostLimits.threads = 1;
+    }
+    // absolute: a session may CHDIR to a D64 image or the CLOUD
+    std::error_code ec;
+    std::filesystem::create_directories(hostLimits.stateDirectory, ec);
+    hostLimits.stateDirectory = std::filesystem::absolute(hostLimits.stateDirectory, ec).string();
+
+    if (!HostSocket::startup()) {
+        return false;
+    }
+    listener = HostSocket::listenOn(address, port, boundPort);
+    if (listener == HostSocket::invalid) {
+        return false;
+    }
+
+    stopRequested   = false;
+    ioStopRequested = false;
+    for (int i = 0; i < hostLimits.threads; ++i) {
+        workers.emplace_back(&SessionHost::workerLoop, this);
+    }
+    ioThread = std::thread(&SessionHost::ioLoop, this);
+    return true;
+}
+
+void SessionHost::stop() {
+    if (listener == HostSocket::invalid) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+        ready.clear();
+        for (auto& it : sessions) {
+            if (it.second->state == Session::State::QUEUED) {
+                it.second->state = Session::State::SUSPENDED;
+            }
+        }
+    }
+    readySignal.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+    workers.clear();
+    ioStopRequested = true;
+    ioThread.join(); // after the workers, so their last frames are sent
+    HostSocket::close(listener);
+}
+
+std::shared_ptr<Connection> SessionHost::connectionOf(Session& session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return session.connection;
+}
+
+std::string SessionHost::statePath(const Session& session) const {
+    return (std::filesystem::path(hostLimits.stateDirectory) / (session.name + ".state67")).string();
+}
+
+// next to the state file, outside the home, so a session cannot read it
+std::string SessionHost::tokenPath(const Session& session) const {
+    return (std::filesystem::path(hostLimits.stateDirectory) / (session.name + ".token")).string();
+}
+
+// next to the state file, so a session cannot overwrite it
+std::string SessionHost::homeDirectory(const Session& session) const {
+    return (std::filesystem::path(hostLimits.stateDirectory) / session.name).lexically_normal().string();
+}
+
+bool SessionHost::sessionsWaiting() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !ready.empty();
+}
+
+Session::State SessionHost::stateOf(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(name);
+    return it != sessions.end() ? it->second->state : Session::State::SUSPENDED;
+}
+
+void SessionHost::enqueue(Session& session) {
+    session.state = Session::State::QUEUED;
+    ready.push_back(&session);
+    readySignal.notify_one();
+    if (busyWorkers + int(ready.size()) > hostLimits.threads && session.connection != nullptr) {
+        std::string frame;
+        HostProtocol::appendFrame(frame, HostProtocol::Frame::NOTICE, "WAITING FOR A FREE WORKER");
+        session.connection->send(frame);
+    }
+}
+
+void SessionHost::workerLoop() {
+    for (;;) {
+        Session* session = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            readySignal.wait(lock, [this]() { return stopRequested || !ready.empty(); });
+            if (ready.empty()) {
+                return; // stopping
+            }
+            session = ready.front();
+            ready.pop_front();
+            session->state = Session::State::RUNNING;
+            ++busyWorkers;
+        }
+        runSession(*session);
+    }
+}
+
+// one interpreter lifetime: resume the saved state, run until suspended, save it
+void SessionHost::runSession(Session& session) {
+    std::string path = statePath(session);
+    std::error_code ec;
+    std::filesystem::create_directories(homeDirectory(session), ec);
+    {
+        MemoryQuota::Scope charge(&session.memory);
+        session.memory.limit = hostLimits.memoryBytes;
+
+        NullSoundSystem sound;
+        auto os                      = std::make_unique<OsSession>(*this, session);
+        os->settings.scrollbackLines = hostLimits.scrollbackLines;
+        os->settings.maxWorkers      = 0; // a worker thread would escape the CPU quota
+        std::unique_ptr<Basic> basic;
+        try {
+            basic = std::make_unique<Basic>(os.get(), &sound);
+            basic->init();
+            if (session.hasState) {
+                os->stateFileAccess = true;
+                basic->loadState(path);
+                os->stateFileAccess = false;
+                os->screen.restoreState(session.screen);
+            }
+        } catch (const std::exception&) {
+            basic.reset(); // not even a fresh interpreter fits the memory quota
+        }
+
+        if (basic != nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                session.os = os.get();
+                for (auto& key : session.pendingKeys) {
+                    os->typeKey(key);
+                }
+                session.pendingKeys.clear();
+                if (!session.lostState.empty() && session.connection != nullptr) {
+                    std::string frame;
+                    HostProtocol::appendFrame(frame, HostProtocol::Frame::NOTICE, session.lostState + " WERE RESET WHILE THE SESSION WAS SUSPENDED");
+                    session.connection->send(frame);
+                }
+                session.lostState.clear();
+            }
+
+            const char* notice = nullptr;
+            try {
+                basic->runInterpreter();
+            } catch (const OsSession::Suspend&) {
+            } catch (const std::bad_alloc&) {
+                notice = "?OUT OF MEMORY ERROR - SESSION RESTARTED";
+            } catch (...) {
+                notice = "?INTERNAL ERROR - SESSION RESTARTED";
+            }
+
+            session.memory.limit = 0; // saving must not fail for the quota
+            try {
+                os->setCurrentDirectory(os->getHomeDirectory()); // not into the CLOUD
+                os->stateFileAccess = true;
+                basic->saveState(path);
+            } catch (...) {
+                fprintf(stderr, "%s: saving %s failed\n", session.name.c_str(), path.c_str());
+            }
+            {
+                MemoryQuota::Scope uncounted(nullptr);
+                session.screen   = os->screen.saveState();
+                session.hasState = true;
+            }
+            os->presentScreen();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            session.os        = nullptr;
+            session.lostState = basic->unsavedState();
+            // keys typed while the interpreter stopped are kept for the next start
+            MemoryQuota::Scope uncounted(nullptr);
+            while (os->keyboardBufferHasData()) {
+                session.pendingKeys.push_back(os->Os::getFromKeyboardBuffer());
+            }
+            if (notice != nullptr && session.connection != nullptr) {
+                std::string frame;
+                HostProtocol::appendFrame(frame, HostProtocol::Frame::NOTICE, notice);
+                session.connection->send(frame);
+            }
+        }
+        basic.reset();
+        os.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    --busyWorkers;
+    session.state = Session::State::SUSPENDED;
+    if (!stopRequested && !session.pendingKeys.empty()) {
+        enqueue(session);
+    }
+}
+
+// the first HELLO for a name gets the session's token. Only who knows it can resume the session.
+bool SessionHost::attach(const std::shared_ptr<Connection>& connection, const std::string& name, const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& session = sessions[name];
+    if (session == nullptr) {
+        session           = std::make_unique<Session>(name);
+        session->hasState = std::filesystem::exists(statePath(*session));
+        if (FILE* file = fopen(tokenPath(*session).c_str(), "rb")) {
+            char text[HostProtocol::tokenLength + 1] = {};
+            session->token.assign(text, fread(text, 1, HostProtocol::tokenLength, file));
+            fclose(file);
+        }
+    }
+    std::string frame;
+    if (session->token.empty()) {
+        std::random_device random;
+        static const char* hex = "0123456789abcdef";
+        for (size_t i = 0; i < HostProtocol::tokenLength; ++i) {
+            session->token += hex[random() & 15];
+        }
+        if (FILE* file = fopen(tokenPath(*session).c_str(), "wb")) {
+            fwrite(session->token.data(), 1, session->token.size(), file);
+            fclose(file);
+        }
+        HostProtocol::appendFrame(frame, HostProtocol::Frame::TOKEN, session->token);
+        connection->send(frame);
+    } else if (token != session->token) {
+        HostProtocol::appendFrame(frame, HostProtocol::Frame::NOTICE, "SESSION " + name + " BELONGS TO ANOTHER CLIENT");
+        connection->send(frame);
+        return false;
+    }
+    if (session->connection != nullptr) {
+        session->connection->closing = true; // the same user, connected again
+    }
+    session->connection     = connection;
+    session->lastInputMs    = now();
+    connection->sessionName = name;
+
+    if (session->os != nullptr) {
+        session->os->sendWholeScreen();
+    } else if (session->state == Session::State::SUSPENDED && !stopRequested) {
+        enqueue(*session);
+    }
+    return true;
+}
+
+void SessionHost::detach(const std::shared_ptr<Connection>& connection) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(connection->sessionName);
+    if (it != sessions.end() && it->second->connection == connection) {
+        it->second->connection = nullptr;
+    }
+}
+
+void SessionHost::deliverKeys(Session& session, const std::vector<Os::KeyPress>& keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    session.lastInputMs = now();
+    if (session.os != nullptr) {
+        for (auto& key : keys) {
+            session.os->typeKey(key);
+        }
+        return;
+    }
+    session.pendingKeys.insert(session.pendingKeys.end(), keys.begin(), keys.end());
+    if (session.state == Session::State::SUSPENDED && !stopRequested) {
+        enqueue(session);
+    }
+}
+
+// false closes the connection
+bool SessionHost::handleFrame(const std::shared_ptr<Connection>& connection, uint8_t type, const std::string& payload) {
+    switch (HostProtocol::Frame(type)) {
+    case HostProtocol::Frame::HELLO:
+        {
+            size_t space     = payload.find(' ');
+            std::string name = payload.substr(0, space);
+            if (!connection->sessionName.empty() || !HostProtocol::isValidSessionName(name)) {
+                return false;
+            }
+            return attach(connection, name, space == std::string::npos ? std::string() : payload.substr(space + 1));
+        }
+    case HostProtocol::Frame::KEYS:
+        {
+            if (connection->sessionName.empty() || payload.size() % HostProtocol::keySize != 0) {
+                return false;
+            }
+            std::vector<Os::KeyPress> keys;
+            for (size_t i = 0; i < payload.size(); i += HostProtocol::keySize) {
+                Os::KeyPress key;
+                key.code      = char32_t(HostProtocol::getU32(&payload[i]));
+                uint8_t flags = uint8_t(payload[i + 4]);
+                key.printable = (flags & HostProtocol::PRINTABLE) != 0;
+                key.holdShift = (flags & HostProtocol::SHIFT) != 0;
+                key.holdAlt   = (flags & HostProtocol::ALT) != 0;
+                key.holdCtrl  = (flags & HostProtocol::CTRL) != 0;
+                keys.push_back(key);
+            }
+            Session* session = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                session = sessions[connection->sessionName].get();
+            }
+            deliverKeys(*session, keys);
+            return true;
+        }
+    default:
+        return false;
+    }
+}
+
+// accepts clients, parses their frames and sends what the sessions queued
+void SessionHost::ioLoop() {
+    std::vector<HostSocket::PollEntry> entries;
+    char buffer[4096];
+    while (!ioStopRequested) {
+        entries.clear();
+        entries.push_back({ listener, POLLIN, 0 });
+        for (auto& c : connections) {
+            bool sending;
+            {
+                std::lock_guard<std::mutex> lock(c->outgoingMutex);
+                sending = !c->outgoing.empty();
+            }
+            entries.push_back({ c->socket, short(POLLIN | (sending ? POLLOUT : 0)), 0 });
+        }
+        // the sessions do not wake this thread. 10 ms is the latency of a frame.
+        HostSocket::poll(entries, 10);
+
+        if ((entries[0].revents & POLLIN) != 0 && !stopRequested) {
+            HostSocket::Handle s;
+            while ((s = HostSocket::accept(listener)) != HostSocket::invalid) {
+                auto c    = std::make_shared<Connection>();
+                c->socket = s;
+                connections.push_back(c);
+            }
+        }
+
+        for (size_t i = 0; i < connections.size(); ++i) {
+            auto& c     = connections[i];
+            bool closed = c->closing;
+            for (;;) {
+                long n = HostSocket::receive(c->socket, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    closed = closed || n < 0;
+                    break;
+                }
+                c->received.append(buffer, size_t(n));
+            }
+
+            HostProtocol::Frame type;
+            std::string payload;
+            bool malformed = false;
+            while (!closed && HostProtocol::takeFrame(c->received, type, payload, malformed)) {
+                closed = !handleFrame(c, uint8_t(type), payload);
+            }
+            closed = closed || malformed;
+
+            {
+                std::lock_guard<std::mutex> lock(c->outgoingMutex);
+                while (!c->outgoing.empty()) {
+                    long n = HostSocket::send(c->socket, c->outgoing.data(), c->outgoing.size());
+                    if (n <= 0) {
+                        closed = closed || n < 0;
+                        break;
+                    }
+                    c->outgoing.erase(0, size_t(n));
+                }
+            }
+
+            if (closed) {
+                detach(c);
+                HostSocket::close(c->socket);
+                connections.erase(connections.begin() + i);
+                --i;
+            }
+        }
+    }
+    for (auto& c : connections) {
+        HostSocket::close(c->socket);
+    }
+    connections.clear();
+}
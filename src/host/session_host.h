@@ -0,0 +1,116 @@
+#pragma once
+#include "host_socket.h"
+#include "memory_quota.h"
+#include "os.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class OsSession;
+
+struct HostLimits {
+    int threads            = 4; // interpreters running at the same time
+    double cpuShare        = 1.0; // of one core, while a program runs. Slower programs sleep.
+    uint64_t cpuLimitMs    = 0; // CPU time of one RUN or direct command before BREAK. 0 = no limit
+    int64_t memoryBytes    = 64 * 1024 * 1024; // heap of one interpreter. 0 = no limit
+    uint64_t idleMs        = 10 * 60 * 1000; // suspend a session at READY after this long without keys
+    size_t scrollbackLines = 200;
+    std::string stateDirectory; // <name>.state67 files of the suspended sessions and the <name> home folders
+};
+
+// one client connection. Owned by the I/O thread, sessions hold it to send.
+struct Connection {
+    HostSocket::Handle socket = HostSocket::invalid;
+    std::string received; // not yet parsed
+    std::string outgoing; // not yet sent
+    std::mutex outgoingMutex;
+    std::string sessionName; // empty until HELLO
+    std::atomic<bool> closing = false;
+
+    void send(const std::string& frame);
+};
+
+// a named BASIC session. It outlives its connections and its interpreter:
+// a SUSPENDED session is only a state file and the last screen.
+class Session {
+public:
+    enum class State { SUSPENDED,
+                       QUEUED,
+                       RUNNING };
+
+    explicit Session(const std::string& name)
+        : name(name) { }
+
+    const std::string name;
+    MemoryQuota::Account& memory = MemoryQuota::newAccount();
+    std::atomic<uint64_t> lastInputMs = 0; // SessionHost::now() of the last key
+
+    // guarded by SessionHost::mutex
+    State state = State::SUSPENDED;
+    std::shared_ptr<Connection> connection;
+    OsSession* os = nullptr; // while RUNNING
+    std::vector<Os::KeyPress> pendingKeys; // typed while not RUNNING
+    bool hasState = false; // statePath() holds the program and memory
+    std::string token; // HELLO must send it to resume, see tokenPath()
+    std::string lostState; // Basic::unsavedState() when it was suspended
+    ScreenBuffer::SaveState screen; // shown again on resume
+};
+
+// BA67host: many BASIC sessions over TCP on a fixed pool of worker threads.
+// A session occupies a worker while its interpreter lives. Sessions that wait
+// at READY without a client or keys for HostLimits::idleMs are saved with
+// Basic::saveState and give their worker to the next queued session.
+class SessionHost {
+public:
+    ~SessionHost() { stop(); }
+
+    bool start(const HostLimits& limits, const std::string& address, int port);
+    void stop(); // running programs get a BREAK, all sessions are saved
+    int port() const { return boundPort; }
+
+    static uint64_t now(); // [ms] steady clock
+
+    // for OsSession
+    const HostLimits& limits() const { return hostLimits; }
+    bool stopping() const { return stopRequested; }
+    std::shared_ptr<Connection> connectionOf(Session& session);
+    std::string statePath(const Session& session) const;
+    std::string tokenPath(const Session& session) const;
+    std::string homeDirectory(const Session& session) const; // the files of the session
+    bool sessionsWaiting(); // for a free worker
+
+    // for tests: the state of a session, SUSPENDED for unknown names
+    Session::State stateOf(const std::string& name);
+
+private:
+    HostLimits hostLimits;
+    int boundPort                     = 0;
+    HostSocket::Handle listener       = HostSocket::invalid;
+    std::atomic<bool> stopRequested   = false;
+    std::atomic<bool> ioStopRequested = false; // after the workers saved their sessions
+
+    std::mutex mutex;
+    std::condition_variable readySignal;
+    std::map<std::string, std::unique_ptr<Session>> sessions;
+    std::deque<Session*> ready; // QUEUED sessions, waiting for a worker
+    int busyWorkers = 0; // guarded by mutex
+
+    std::vector<std::thread> workers;
+    std::thread ioThread;
+    std::vector<std::shared_ptr<Connection>> connections; // I/O thread only
+
+    void workerLoop();
+    void runSession(Session& session);
+    void ioLoop();
+    bool handleFrame(const std::shared_ptr<Connection>& connection, uint8_t type, const std::string& payload);
+    bool attach(const std::shared_ptr<Connection>& connection, const std::string& name, const std::string& token); // false for a wrong token
+    void detach(const std::shared_ptr<Connection>& connection);
+    void deliverKeys(Session& session, const std::vector<Os::KeyPress>& keys);
+    void enqueue(Session& session); // mutex held
+};
@@ -673,6 +673,16 @@ bool IPC::hasData() {
     return !imp->inBuf.empty();
 }
 
+size_t IPC::inputPending() {
+    std::lock_guard<std::mutex> lock(imp->inMutex);
+    return imp->inBuf.size();
+}
+
+size_t IPC::outputPending() {
+    std::lock_guard<std::mutex> lock(imp->outMutex);
+    return imp->outBuf.size();
+}
+
 uint8_t IPC::getc() {
     std::lock_guard<std::mutex> lock(imp->inMutex);
     uint8_t b = imp->inBuf.front();
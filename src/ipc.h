@@ -51,6 +51,10 @@ public:
     // input cache has data?
     bool hasData();
 
+    // bytes waiting in the input and output caches
+    size_t inputPending();
+    size_t outputPending();
+
     // input from input cache
     uint8_t getc();
 
@@ -30,7 +30,12 @@ using OsSoundsystem = SoundSystemSoLoud;
 #endif
 
 #include "basic.h"
+#include "os_batch.h"
 #include "unicode.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <vector>
 
@@ -52,6 +57,11 @@ Os* getOsConsole() {
     return &os;
 }
 
+Os* getOsBatch() {
+    static OsBatch os;
+    return &os;
+}
+
 
 
 #if _DEBUG
@@ -82,6 +92,7 @@ int main(){
 #endif
 
 void printfHelp();
+int runBatch(const std::vector<std::string>& args, const BA68settings& sets);
 
 // ---------------------------------------
 // MAIN
@@ -117,14 +128,18 @@ int main(int argc, char** argv) {
 #endif
 
 
-    auto& sets = Os::settings;
+    BA68settings sets;
+    // stdout is reserved for the program output in batch mode
+    auto hasArg    = [&](const char* name) { return std::find(args.begin(), args.end(), name) != args.end(); };
+    sets.benchmark = hasArg("--bench");
+    sets.batchMode = hasArg("--batch") || sets.benchmark;
 
 #if defined(BA67_GRAPHICS_ENABLE_OPENGL_ON)
     sets.renderMode = BA68settings::RenderMode::OpenGL;
 #endif
 
     #if defined(__linux__)
-    if (!getenv("DISPLAY")) {
+    if (!getenv("DISPLAY") && !sets.batchMode) {
         printf("DISPLAY not set. Missing X11 display, default to text-output.\n");
         sets.renderMode = BA68settings::RenderMode::Text;
     }
@@ -134,7 +149,9 @@ int main(int argc, char** argv) {
     args.push_back(""); // ensure [i] and [i+1]
     for (size_t i = 0; i + 1 < args.size(); ++i) {
 
-        printf("%s\n", args[i].c_str());
+        if (!sets.batchMode) {
+            printf("%s\n", args[i].c_str());
+        }
 
         if (args[i] == "--help") {
             printfHelp();
@@ -169,12 +186,35 @@ int main(int argc, char** argv) {
                 sets.demoMode = false;
             }
         }
+        if (args[i] == "--scrollback") {
+            sets.scrollbackLines = size_t(std::max(0, atoi(args[i + 1].c_str())));
+        }
+        if (args[i] == "--timeout") {
+            sets.timeLimitMs = uint64_t(std::max(0.0, atof(args[i + 1].c_str())) * 1000.0);
+        }
+        if (args[i] == "--steps") {
+            sets.stepLimit = strtoull(args[i + 1].c_str(), nullptr, 10);
+        }
+        if (args[i] == "--keys") {
+            sets.keysFile = args[i + 1];
+        }
+        if (args[i] == "--golden") {
+            sets.goldenFile = args[i + 1];
+        }
+        if (args[i] == "--record") {
+            sets.recordGolden = true;
+        }
+    }
+
+    if (sets.batchMode) {
+        return runBatch(args, sets);
     }
 
     // OsBackend os;
     OsSoundsystem sound;
 
-    Os* os = (sets.renderMode == BA68settings::RenderMode::Text) ? getOsConsole() : getOsGraphics();
+    Os* os       = (sets.renderMode == BA68settings::RenderMode::Text) ? getOsConsole() : getOsGraphics();
+    os->settings = sets;
     Basic basic(os, &sound);
     basic.init();
 
@@ -220,4 +260,91 @@ void printfHelp() {
     printf("               false        disable the CRT RGB emulation\n");
     printf("--demo         true         demo mode - slow typing\n");
     printf("               false        (default) normal mode\n");
+    printf("--scrollback   1000         (default) lines to keep above the screen\n");
+    printf("--batch                     no window. PRINT to stdout, INPUT from stdin.\n");
+    printf("                            Runs the .bas file or the lines from stdin.\n");
+    printf("                            Exit code: QUIT n, 1 on an error\n");
+    printf("--timeout      seconds      batch: stop the program after this time (exit code 124)\n");
+    printf("--steps        n            batch: stop the program after n statements (exit code 124)\n");
+    printf("--bench                     batch: run each .bas file and print the timing as JSON\n");
+    printf("--keys         file         batch: type the keys of this UTF-8 text file\n");
+    printf("--golden       file         batch: compare stdout and the final screen with this file.\n");
+    printf("                            Exit code 0 if they match, 1 if they differ or it is missing.\n");
+    printf("--record                    batch: write the --golden file instead of comparing\n");
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string json = "\"";
+    for (char c : s) {
+        if (c == '\"' || c == '\\') {
+            json += '\\';
+        }
+        json += c;
+    }
+    return json + "\"";
+}
+
+// --bench: run each .bas file and print the statements per second as JSON.
+// An op is one executed statement. exit_code is the QUIT value, 1 after an error.
+static int runBenchmarks(Basic& basic, const std::vector<std::string>& args) {
+    int exitCode = 0;
+    printf("{\n  \"version\": %s,\n  \"cases\": [", jsonString(Basic::version()).c_str());
+    const char* separator = "\n";
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (!args[i].ends_with(".bas") && !args[i].ends_with(".ba67")) {
+            continue;
+        }
+        std::string path = args[i];
+        int caseExitCode = 2;
+        double seconds   = 0.0;
+        basic.batchSteps = 0;
+        basic.quitCode   = 0;
+        if (basic.loadProgram(path)) {
+            auto start   = std::chrono::steady_clock::now();
+            bool failed  = basic.parseInput("RUN") == Basic::ParseStatus::PS_ERROR;
+            seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            caseExitCode = failed ? 1 : basic.quitCode;
+        }
+        if (caseExitCode != 0) {
+            exitCode = 1;
+        }
+
+        double steps = double(basic.batchSteps);
+        printf("%s    { \"name\": %s, \"statements\": %llu, \"seconds\": %.6f, \"statements_per_sec\": %.0f, \"ns_per_op\": %.2f, \"exit_code\": %d }",
+               separator,
+               jsonString(std::filesystem::path(args[i]).stem().string()).c_str(),
+               (unsigned long long)basic.batchSteps,
+               seconds,
+               seconds > 0.0 ? steps / seconds : 0.0,
+               steps > 0.0 ? seconds * 1e9 / steps : 0.0,
+               caseExitCode);
+        separator = ",\n";
+    }
+    printf("\n  ]\n}\n");
+    return exitCode;
+}
+
+// --batch: no window, no sound and no boot.bas.
+// Runs the first .bas file or the lines from stdin.
+int runBatch(const std::vector<std::string>& args, const BA68settings& sets) {
+    NullSoundSystem sound;
+    Os* os       = getOsBatch();
+    os->settings = sets;
+    Basic basic(os, &sound);
+    basic.init();
+    if (sets.benchmark) {
+        return runBenchmarks(basic, args);
+    }
+
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i].ends_with(".bas") || args[i].ends_with(".ba67")) {
+            std::string path = args[i];
+            if (!basic.loadProgram(path)) {
+                fprintf(stderr, "%s not found\n", args[i].c_str());
+                return 2;
+            }
+            return basic.finishBatch(basic.parseInput("RUN") == Basic::ParseStatus::PS_ERROR ? 1 : 0);
+        }
+    }
+    return basic.finishBatch(basic.runBatch());
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "mat_kernels.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// "omp simd" needs OpenMP 4.0. MSVC only has 2.0.
+#if defined(_OPENMP) && _OPENMP >= 201307
+    #define MAT_SIMD _Pragma("omp simd")
+    #define MAT_SIMD_SUM _Pragma("omp simd reduction(+ : s)")
+#else
+    #define MAT_SIMD
+    #define MAT_SIMD_SUM
+#endif
+
+namespace MatKernels {
+    // elements per work item. Small enough to stay in the L1 cache.
+    static const size_t chunkSize = 4096;
+
+    // calls f(begin, end) for each chunk of [0..n). In parallel for large n.
+    template <typename F>
+    static void forChunks(size_t n, F f) {
+        const int64_t chunks = int64_t((n + chunkSize - 1) / chunkSize);
+#pragma omp parallel for schedule(static) if (n >= parallelThreshold)
+        for (int64_t c = 0; c < chunks; ++c) {
+            size_t begin = size_t(c) * chunkSize;
+            f(begin, std::min(n, begin + chunkSize));
+        }
+    }
+
+    // the partial sums are added in chunk order, so the result
+    // does not depend on the number of threads.
+    template <typename T, typename F>
+    static T sumChunks(size_t n, F f) {
+        std::vector<T> partial((n + chunkSize - 1) / chunkSize);
+        forChunks(n, [&](size_t begin, size_t end) { partial[begin / chunkSize] = f(begin, end); });
+        T s = 0;
+        for (T p : partial) {
+            s += p;
+        }
+        return s;
+    }
+
+    template <typename T>
+    void fill(T* dst, size_t n, T value) {
+        forChunks(n, [=](size_t begin, size_t end) {
+            MAT_SIMD
+            for (size_t i = begin; i < end; ++i) {
+                dst[i] = value;
+            }
+        });
+    }
+
+    template <typename T>
+    void copy(T* dst, const T* a, size_t n) {
+        if (dst == a) {
+            return;
+        }
+        forChunks(n, [=](size_t begin, size_t end) { std::copy(a + begin, a + end, dst + begin); });
+    }
+
+    template <typename T>
+    void add(T* dst, const T* a, const T* b, size_t n) {
+        forChunks(n, [=](size_t begin, size_t end) {
+            MAT_SIMD
+            for (size_t i = begin; i < end; ++i) {
+                dst[i] = a[i] + b[i];
+            }
+        });
+    }
+
+    template <typename T>
+    void subtract(T* dst, const T* a, const T* b, size_t n) {
+        forChunks(n, [=](size_t begin, size_t end) {
+            MAT_SIMD
+            for (size_t i = begin; i < end; ++i) {
+                dst[i] = a[i] - b[i];
+            }
+        });
+    }
+
+    template <typename T>
+    void scale(T* dst, const T* a, T factor, size_t n) {
+        forChunks(n, [=](size_t begin, size_t end) {
+            MAT_SIMD
+            for (size_t i = begin; i < end; ++i) {
+                dst[i] = a[i] * factor;
+            }
+        });
+    }
+
+    template <typename T>
+    void identity(T* dst, size_t rows, size_t cols) {
+        fill(dst, rows * cols, T(0));
+        for (size_t i = 0; i < std::min(rows, cols); ++i) {
+            dst[i + i * rows] = T(1);
+        }
+    }
+
+    template <typename T>
+    void transpose(T* dst, const T* a, size_t rows, size_t cols) {
+        // 32x32 tiles, so neither side strides through the whole memory
+        const size_t tile      = 32;
+        const int64_t colTiles = int64_t((cols + tile - 1) / tile);
+#pragma omp parallel for schedule(static) if (rows * cols >= parallelThreshold)
+        for (int64_t t = 0; t < colTiles; ++t) {
+            size_t j0 = size_t(t) * tile;
+            size_t j1 = std::min(cols, j0 + tile);
+            for (size_t i0 = 0; i0 < rows; i0 += tile) {
+                size_t i1 = std::min(rows, i0 + tile);
+                for (size_t j = j0; j < j1; ++j) {
+                    for (size_t i = i0; i < i1; ++i) {
+                        dst[j + i * cols] = a[i + j * rows];
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    void multiply(T* dst, const T* a, const T* b, size_t rows, size_t inner, size_t cols) {
+        // one result column per work item: dst(:,j) = sum a(:,p) * b(p,j).
+        // The inner loop runs down a column of a, which is contiguous.
+        const int64_t ncols = int64_t(cols);
+#pragma omp parallel for schedule(static) if (rows * inner * cols >= parallelThreshold)
+        for (int64_t jj = 0; jj < ncols; ++jj) {
+            size_t j    = size_t(jj);
+            T* out      = dst + j * rows;
+            std::fill(out, out + rows, T(0));
+            for (size_t p = 0; p < inner; ++p) {
+                const T bpj = b[p + j * inner];
+                const T* ap = a + p * rows;
+                MAT_SIMD
+                for (size_t i = 0; i < rows; ++i) {
+                    out[i] += ap[i] * bpj;
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    T sum(const T* a, size_t n) {
+        return sumChunks<T>(n, [=](size_t begin, size_t end) {
+            T s = 0;
+            MAT_SIMD_SUM
+            for (size_t i = begin; i < end; ++i) {
+                s += a[i];
+            }
+            return s;
+        });
+    }
+
+    template <typename T>
+    T dot(const T* a, const T* b, size_t n) {
+        return sumChunks<T>(n, [=](size_t begin, size_t end) {
+            T s = 0;
+            MAT_SIMD_SUM
+            for (size_t i = begin; i < end; ++i) {
+                s += a[i] * b[i];
+            }
+            return s;
+        });
+    }
+
+    // the element types of Basic::Array: REAL and INTEGER%
+#define MAT_INSTANTIATE(T)                                                                 \
+    template void fill<T>(T*, size_t, T);                                                  \
+    template void copy<T>(T*, const T*, size_t);                                           \
+    template void add<T>(T*, const T*, const T*, size_t);                                  \
+    template void subtract<T>(T*, const T*, const T*, size_t);                             \
+    template void scale<T>(T*, const T*, T, size_t);                                       \
+    template void identity<T>(T*, size_t, size_t);                                         \
+    template void transpose<T>(T*, const T*, size_t, size_t);                              \
+    template void multiply<T>(T*, const T*, const T*, size_t, size_t, size_t);             \
+    template T sum<T>(const T*, size_t);                                                   \
+    template T dot<T>(const T*, const T*, size_t);
+    MAT_INSTANTIATE(double)
+    MAT_INSTANTIATE(int64_t)
+#undef MAT_INSTANTIATE
+} // namespace MatKernels
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+
+// Native kernels for the MAT statements.
+// Arrays are stored like Basic::Array: the first index runs fastest,
+// so a matrix A(rows-1, cols-1) has the element (i,j) at a[i + j * rows].
+// Large arrays are split across the cores with OpenMP, the inner loops
+// are plain contiguous loops the compiler can vectorize.
+namespace MatKernels {
+    // element count from which the work is split across threads
+    constexpr size_t parallelThreshold = 1 << 15;
+
+    // T is double for real arrays and int64_t for % arrays.
+    template <typename T> void fill(T* dst, size_t n, T value);
+    template <typename T> void copy(T* dst, const T* a, size_t n);
+    template <typename T> void add(T* dst, const T* a, const T* b, size_t n);
+    template <typename T> void subtract(T* dst, const T* a, const T* b, size_t n);
+    template <typename T> void scale(T* dst, const T* a, T factor, size_t n);
+    template <typename T> void identity(T* dst, size_t rows, size_t cols);
+
+    // dst(cols x rows) = a(rows x cols)^T. dst must not alias a.
+    template <typename T> void transpose(T* dst, const T* a, size_t rows, size_t cols);
+    // dst(rows x cols) = a(rows x inner) * b(inner x cols). dst must not alias a or b.
+    template <typename T> void multiply(T* dst, const T* a, const T* b, size_t rows, size_t inner, size_t cols);
+
+    template <typename T> T sum(const T* a, size_t n);
+    template <typename T> T dot(const T* a, const T* b, size_t n);
+} // namespace MatKernels
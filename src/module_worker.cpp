@@ -0,0 +1,196 @@
+#include "module_worker.h"
+#include "basic.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+bool Channel::tryPush(const BA67::Value& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size() >= capacity) {
+        return false;
+    }
+    queue.push_back(value);
+    changed.notify_all();
+    return true;
+}
+
+Channel::Pop Channel::tryPop(BA67::Value& value, bool wantString) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty()) {
+        return Pop::EMPTY;
+    }
+    if (ValueIsString(queue.front()) != wantString) {
+        return Pop::WRONG_TYPE;
+    }
+    value = std::move(queue.front());
+    queue.pop_front();
+    changed.notify_all();
+    return Pop::OK;
+}
+
+size_t Channel::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+void Channel::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    isClosed = true;
+    changed.notify_all();
+}
+
+bool Channel::closed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return isClosed;
+}
+
+void Channel::wait(int ms) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait_for(lock, std::chrono::milliseconds(ms));
+}
+
+
+// Headless backend of a worker. Its screen is never shown and there are no
+// keys. The parent stops the program with ModuleWorker::stopRequested.
+class OsWorker : public Os {
+public:
+    OsWorker(const std::atomic<bool>& stopRequested, const std::string& home)
+        : stopRequested(stopRequested)
+        , home(home) { }
+
+    bool init(Basic* basic, SoundSystem* sound) override {
+        Os::init(basic, sound);
+        screen.setSize(80, 25);
+        return true;
+    }
+    void updateEvents() override {
+        if (stopRequested) {
+            throw BA67::Error(BA67::ErrorId::BREAK);
+        }
+    }
+
+    uint64_t tick() const override {
+        return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    void delay(int ms) override {
+        while (ms > 0) {
+            int slice = std::min(ms, 10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(slice));
+            ms -= slice;
+            updateEvents();
+        }
+    }
+
+    void presentScreen() override { }
+
+    const bool isKeyPressed(char32_t index, bool withShift = false, bool withAlt = false, bool withCtrl = false) const override { return false; }
+    KeyPress getFromKeyboardBuffer() override { throw BA67::Error(BA67::ErrorId::OUT_OF_DATA); } // INPUT and GETKEY
+
+    // the working directory belongs to the process and the parent. A worker
+    // starts in the parent's and keeps its own, relative paths are resolved against it.
+    std::string getHomeDirectory() override { return home; }
+    std::string getCurrentDirectory() override {
+        if (dirIsInCloud() || dirIsInD64() || dirIsInSerial()) {
+            return Os::getCurrentDirectory();
+        }
+        return dir;
+    }
+    bool setCurrentDirectory(const std::string& path) override {
+        if (path == "CLOUD" || path == "SERIALPORTS") {
+            return Os::setCurrentDirectory(path);
+        }
+        std::string local = localPath(path);
+        if (local.empty()) {
+            return false;
+        }
+        if (path.ends_with(".d64") || path.ends_with(".D64")) {
+            return Os::setCurrentDirectory(local);
+        }
+        std::error_code ec;
+        if (!std::filesystem::is_directory(local, ec)) {
+            return false;
+        }
+        dir = local;
+        setCurrentDirectoryLocal();
+        return true;
+    }
+    std::string localPath(const std::string& pathUtf8) override {
+        if (pathUtf8.empty()) {
+            return {};
+        }
+        std::filesystem::path path = (std::filesystem::path(dir) / pathUtf8).lexically_normal(); // dir / an absolute path is the absolute path
+        if (!path.has_filename() && path.has_relative_path()) {
+            path = path.parent_path(); // "sub/" and "sub/." name sub
+        }
+        return path.string();
+    }
+
+private:
+    const std::atomic<bool>& stopRequested;
+    std::string home;
+    std::string dir = (const char*)(std::filesystem::current_path().u8string().c_str()); // until init() changes to home
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+
+ModuleWorker::ModuleWorker(Basic& parent, const std::string& name, const std::string& module, size_t capacity)
+    : name(name)
+    , toWorker(capacity)
+    , toParent(capacity) {
+    sound = std::make_unique<NullSoundSystem>();
+    os    = std::make_unique<OsWorker>(stopRequested, parent.os->getCurrentDirectory());
+
+    // the window and batch settings are the parent's business
+    os->settings                 = parent.os->settings;
+    os->settings.batchMode       = false;
+    os->settings.benchmark       = false;
+    os->settings.timeLimitMs     = 0;
+    os->settings.stepLimit       = 0;
+    os->settings.scrollbackLines = 0;
+    os->settings.keysFile.clear();
+    os->settings.goldenFile.clear();
+
+    basic = std::make_unique<Basic>(os.get(), sound.get());
+    basic->init();
+    basic->options  = parent.options;
+    basic->asWorker = this;
+
+    // the code only. Tokens are rebuilt by the worker's own keyword tables.
+    auto& listing = basic->currentModule().listing;
+    for (auto& ln : parent.modules[module].listing) {
+        if (ln.first >= 0) {
+            listing[ln.first].code = ln.second.code;
+        }
+    }
+    basic->currentModule().forceTokenizing();
+
+    thread = std::thread(&ModuleWorker::run, this);
+}
+
+ModuleWorker::~ModuleWorker() {
+    stopRequested = true;
+    toWorker.close(); // wakes a RECV("PARENT")
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+std::string ModuleWorker::status() const {
+    if (!finished) {
+        return "RUNNING";
+    }
+    return error.empty() ? std::string("ENDED") : "?" + error;
+}
+
+void ModuleWorker::run() {
+    try {
+        if (basic->parseInput("RUN") == Basic::ParseStatus::PS_ERROR) {
+            error = basic->lastError;
+        }
+    } catch (...) {
+        error = "INTERNAL ERROR";
+    }
+    finished = true; // before the close, POLL -1 means ENDED
+    toParent.close(); // RECV gets what was sent, then OUT OF DATA
+    toWorker.close(); // SEND fails
+}
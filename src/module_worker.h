@@ -0,0 +1,69 @@
+#pragma once
+#include "value.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class Basic;
+class Os;
+class SoundSystem;
+
+// WORKER: a bounded queue of values between two interpreters.
+// Each value keeps its type, RECV and RECV$ check it.
+class Channel {
+public:
+    enum class Pop { OK,
+                     EMPTY,
+                     WRONG_TYPE };
+
+    explicit Channel(size_t capacity)
+        : capacity(capacity) { }
+
+    bool tryPush(const BA67::Value& value); // false if full
+    Pop tryPop(BA67::Value& value, bool wantString); // a WRONG_TYPE value stays
+    size_t size() const;
+
+    // the sender ended. What was sent can still be received.
+    void close();
+    bool closed() const;
+
+    // wait up to ms for a push, pop or close
+    void wait(int ms);
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<BA67::Value> queue;
+    size_t capacity;
+    bool isClosed = false;
+};
+
+// WORKER name$: a copy of a module's listing in an interpreter of its own,
+// running on its own thread. Several workers can run the same module. It shares nothing with its parent but the two
+// channels: toWorker for SEND name$ and toParent for SEND "PARENT".
+class ModuleWorker {
+public:
+    ModuleWorker(Basic& parent, const std::string& name, const std::string& module, size_t capacity);
+    ~ModuleWorker(); // stops the program with a BREAK and waits for the thread
+
+    const std::string name;
+    Channel toWorker, toParent;
+    std::atomic<bool> stopRequested = false;
+
+    bool running() const { return !finished; }
+    std::string status() const; // RUNNING, ENDED or the error
+
+private:
+    std::unique_ptr<SoundSystem> sound;
+    std::unique_ptr<Os> os;
+    std::unique_ptr<Basic> basic;
+    std::thread thread;
+    std::atomic<bool> finished = false;
+    std::string error; // written by the thread before finished
+
+    void run();
+};
@@ -11,21 +11,26 @@
 #include "control_characters.h"
 #include "serial-io.h"
 
-// static instance
-BA68settings Os::settings = {};
-
 Os::KeyPress Os::getFromKeyboardBuffer() {
     while (!keyboardBufferHasData() && getMouseStatus().buttonBits == 0) {
-        delay(150); // this cools the CPU when we wait for keyboard input
         updateEvents();
         presentScreen();
+        if (basic != nullptr) {
+            basic->dumpStatsIfDue();
+        }
+        waitForKeyboard(16); // this cools the CPU when we wait for keyboard input
     }
 
     Os::KeyPress k;
-    if (keyboardBufferHasData()) {
-        k = keyboardBuffer.back();
-        keyboardBuffer.pop_back();
-        pokeKeyboardBuffer();
+    {
+        std::lock_guard<std::mutex> lock(keyboardMutex);
+        if (keyboardBuffer.pop(k)) {
+            // refill from pasted text
+            while (!keyboardOverflow.empty() && keyboardBuffer.push(keyboardOverflow.front())) {
+                keyboardOverflow.pop_front();
+            }
+            keyboardMemoryDirty = true;
+        }
     }
     if (settings.demoMode) {
         delay(200);
@@ -35,26 +40,57 @@ Os::KeyPress Os::getFromKeyboardBuffer() {
 }
 
 Os::KeyPress Os::peekKeyboardBuffer() const {
+    std::lock_guard<std::mutex> lock(keyboardMutex);
     if (keyboardBuffer.empty()) {
         return {};
     }
-    return keyboardBuffer.back();
+    return keyboardBuffer.front();
 }
 
 void Os::putToKeyboardBuffer(Os::KeyPress key, bool applyBufferLimit) {
     // key.debug();
-    keyboardBuffer.insert(keyboardBuffer.begin(), key);
+    std::lock_guard<std::mutex> lock(keyboardMutex);
+    if (applyBufferLimit) {
+        if (!keyboardBuffer.push(key)) {
+            Os::KeyPress oldest; // full - drop the oldest key
+            keyboardBuffer.pop(oldest);
+            keyboardBuffer.push(key);
+        }
+    } else if (!keyboardOverflow.empty() || !keyboardBuffer.push(key)) {
+        keyboardOverflow.push_back(key);
+    }
+    keyboardMemoryDirty = true;
+    keyboardSignal.notify_one();
+}
 
-    // Keep buffer size limited
-    if (applyBufferLimit && keyboardBuffer.size() > 128 * 1024) {
-        keyboardBuffer.pop_back();
+bool Os::keyboardBufferContains(char32_t code) const {
+    std::lock_guard<std::mutex> lock(keyboardMutex);
+    for (size_t i = 0, n = keyboardBuffer.size(); i < n; ++i) {
+        if (keyboardBuffer.at(i).code == code) {
+            return true;
+        }
     }
-    pokeKeyboardBuffer();
+    return false;
+}
+
+bool Os::waitForKeyboard(int ms) {
+#if defined(__EMSCRIPTEN__)
+    delay(ms); // must yield to the browser
+    return !keyboardBuffer.empty();
+#else
+    std::unique_lock<std::mutex> lock(keyboardMutex);
+    return keyboardSignal.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return !keyboardBuffer.empty(); });
+#endif
 }
 
 void Os::pokeKeyboardBuffer() {
-    static uint8_t cbmMap[256] = {};
-    if (cbmMap[255] == 0) {
+    if (!keyboardMemoryDirty.exchange(false) || basic == nullptr) {
+        return;
+    }
+
+    // built once, thread safe
+    static const std::array<uint8_t, 256> cbmMap = [] {
+        std::array<uint8_t, 256> cbmMap = {};
         for (size_t i = 0; i < 0x100; ++i) {
             cbmMap[i] = uint8_t(i);
         }
@@ -72,15 +108,17 @@ void Os::pokeKeyboardBuffer() {
         cbmMap[int(Os::KeyConstant::HOME)]       = ControlCharacters::cursorHome;
         cbmMap[int(Os::KeyConstant::END)]        = ControlCharacters::cursorHome;
         cbmMap[int(Os::KeyConstant::END)]        = ControlCharacters::cursorHome;
-    }
+        return cbmMap;
+    }();
 
+    std::lock_guard<std::mutex> lock(keyboardMutex);
     size_t bufsz = keyboardBuffer.size();
     if (bufsz > 9) {
         bufsz = 9;
     }
     basic->cpu.RAM[krnl.NDX] = MEMCELL(bufsz);
     for (size_t i = 0; i < bufsz; ++i) {
-        auto& kp  = keyboardBuffer[bufsz - i - 1];
+        auto& kp  = keyboardBuffer.at(i);
         auto code = kp.code;
         if (code == '\n') {
             code = '\r';
@@ -207,7 +245,7 @@ std::vector<Os::FileInfo> Os::listCurrentDirectory() {
                 continue;
             }
             info.isDirectory = false;
-            info.filesize    = entry.data.size();
+            info.filesize    = entry.size;
             info.name        = entry.name;
             files.push_back(info);
         }
@@ -221,7 +259,8 @@ std::vector<Os::FileInfo> Os::listCurrentDirectory() {
         }
     } else {
         Os::FileInfo info = {};
-        for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::current_path())) {
+        std::error_code ec; // an empty localPath lists nothing
+        for (const auto& entry : std::filesystem::directory_iterator(localPath("."), ec)) {
             info.isDirectory = entry.is_directory();
             info.filesize    = info.isDirectory ? 0 : entry.file_size();
             info.name        = (const char*)(entry.path().filename().u8string().c_str());
@@ -248,7 +287,8 @@ bool Os::doesFileExist(const std::string& path) {
         s.close();
         return rv;
     } else {
-        return std::filesystem::exists(path);
+        std::string local = localPath(path);
+        return !local.empty() && std::filesystem::exists(local);
     }
 }
 
@@ -270,7 +310,8 @@ bool Os::isDirectory(const std::string& path) {
         return true;
     }
     // TODO D64?
-    return std::filesystem::is_directory(path);
+    std::string local = localPath(path);
+    return !local.empty() && std::filesystem::is_directory(local);
 }
 
 bool Os::scratchFile(const std::string& fileName) {
@@ -295,23 +336,18 @@ bool Os::scratchFile(const std::string& fileName) {
 
         return true;
     } else if (currentDir == Os::IsD64) {
-        bool didDelete = false;
-        for (size_t i = 0; i < D64Img.files.size(); ++i) {
-            if (D64Img.files[i].name == fileName) {
-                D64Img.files.erase(D64Img.files.begin() + i);
-                --i;
-                didDelete = true;
-            }
+        if (D64Img.path() != D64Path) {
+            D64Img.load(D64Path);
         }
-        if (didDelete) {
-            return D64Img.save(D64Path);
+        if (D64Img.removeFile(fileName)) {
+            return D64Img.flush();
         }
     } else if (currentDir == Os::IsSerial) {
         return false;
 
     } else {
         if (doesFileExist(fileName)) {
-            return std::filesystem::remove(fileName.c_str());
+            return std::filesystem::remove(localPath(fileName));
         }
     }
     return false;
@@ -383,20 +419,12 @@ bool Os::init(Basic* basic, SoundSystem* ss) {
     sound       = ss;
     sound->os   = this;
     this->basic = basic;
+    screen.setScrollbackDepth(settings.scrollbackLines);
     setCurrentDirectory(getHomeDirectory());
     return true;
 }
 
 bool Os::keyboardBufferHasData() {
-    static uint64_t nextPoll = 0;
-
-    if (keyboardBuffer.empty()) {
-        // uint64_t now = tick();
-        // if (nextPoll < now) {
-        //     nextPoll = now + 10;
-        //     updateEvents();
-        // }
-    }
     return !keyboardBuffer.empty();
 }
 
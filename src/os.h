@@ -1,10 +1,16 @@
 #pragma once
 #include "screen_buffer.h"
+#include <atomic>
 #include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "fileptr.h"
 #include "d64.h"
+#include "spsc_ring.h"
 
 class Basic;
 class Os;
@@ -36,6 +42,39 @@ public:
     RenderMode::Enum renderMode = RenderMode::Software;
     bool emulateCRT             = true;
     bool demoMode               = false; // slowly process the input buffer for creating videos
+    size_t scrollbackLines      = 1000; // lines kept when the text scrolls out of the screen
+    bool batchMode              = false; // headless: PRINT to stdout, INPUT from stdin
+    uint64_t timeLimitMs        = 0; // batch mode: stop the program after this time. 0 = no limit
+    uint64_t stepLimit          = 0; // batch mode: stop the program after this many statements. 0 = no limit
+    bool benchmark              = false; // --bench: batch mode, time each .bas file and report JSON
+    std::string keysFile; // batch mode: keystrokes to type, UTF-8 text
+    std::string goldenFile; // batch mode: compare the output and the final screen with this file
+    bool recordGolden = false; // --record: write goldenFile instead of comparing
+#if defined(__EMSCRIPTEN__)
+    size_t maxWorkers = 0; // no threads in the browser
+#else
+    size_t maxWorkers = 16; // WORKER threads of one interpreter. 0 disables WORKER.
+#endif
+};
+
+// STATS: adds the lifetime of the object to a nanosecond counter
+class ScopedNanoseconds {
+public:
+    ScopedNanoseconds(uint64_t& total, uint64_t* maximum = nullptr)
+        : total(total)
+        , maximum(maximum) { }
+    ~ScopedNanoseconds() {
+        uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        total += ns;
+        if (maximum != nullptr && ns > *maximum) {
+            *maximum = ns;
+        }
+    }
+
+private:
+    uint64_t& total;
+    uint64_t* maximum;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 };
 
 class Os {
@@ -65,6 +104,12 @@ public:
     // Screen buffer
     ScreenBuffer screen {};
     virtual void presentScreen() = 0; // copy off-screen buffer to visible window
+
+    // STATS: frames that presentScreen actually rendered.
+    // Backends put a ScopedNanoseconds(frameNanoseconds, &maxFrameNanoseconds) around the rendering.
+    uint64_t frames              = 0;
+    uint64_t frameNanoseconds    = 0;
+    uint64_t maxFrameNanoseconds = 0;
     virtual void setBorderColor(int colorIndex) { };
     virtual size_t getFreeMemoryInBytes() { return 122365; }
 
@@ -153,9 +198,23 @@ public:
     // peek and return the last key on the stack. Do not wait.
     virtual KeyPress peekKeyboardBuffer() const;
 
-    // pushes a key-press to the keyboard buffer. Drops overflow keys.
+    // pushes a key-press to the keyboard buffer. A full buffer drops the oldest key.
+    // Any thread may call this. applyBufferLimit=false queues the overflow instead (pasting).
     virtual void putToKeyboardBuffer(Os::KeyPress key, bool applyBufferLimit = true);
 
+    // is a key with this code waiting in the keyboard buffer?
+    bool keyboardBufferContains(char32_t code) const;
+
+    // keys waiting, including pasted keys that did not fit the ring
+    size_t keyboardBufferSize() const {
+        std::lock_guard<std::mutex> lock(keyboardMutex);
+        return keyboardBuffer.size() + keyboardOverflow.size();
+    }
+
+    // mirror the keyboard buffer to NDX/KEYD in RAM.
+    // Cheap - only does work when the buffer changed since the last call.
+    void pokeKeyboardBuffer();
+
     // get/set utf8 clipboard text data
     virtual std::string getClipboardData() { return {}; }
     virtual void setClipboardData(const std::string utf8) { (void)utf8; };
@@ -164,8 +223,9 @@ public:
         return {};
     }
 
-private:
-    void pokeKeyboardBuffer();
+protected:
+    // block until a key was put or the timeout [ms] elapsed
+    bool waitForKeyboard(int ms);
 
 public:
     // --- JOYPADS ---
@@ -220,6 +280,8 @@ public:
     virtual bool isRelativePath(const std::string& path);
     virtual bool isDirectory(const std::string& path);
     virtual bool scratchFile(const std::string& fileName);
+    // the path to open for a local file name. Empty when the name is not allowed.
+    virtual std::string localPath(const std::string& pathUtf8) { return pathUtf8; }
     virtual int systemCall(const std::string& commandLineUtf8, bool printOutput = true);
 
     std::string findFirstFileNameWildcard(std::string filenameUtf8, bool isDirectory = false);
@@ -249,15 +311,23 @@ private:
     CurrentDirIs currentDir = IsLocal;
     std::string cloudUserHash() const;
 
+protected:
+    void setCurrentDirectoryLocal() { currentDir = IsLocal; } // without changing the process' directory
 
 public:
-    // Command-line settings
-    static BA68settings settings;
+    // Command-line settings of this session. Set them before init().
+    BA68settings settings;
 
 protected:
     Basic* basic = nullptr;
     int foregnd = 1, bkgnd = 0;
-    std::vector<Os::KeyPress> keyboardBuffer;
+    // several threads push keys. keyboardMutex guards every push, pop and scan.
+    // empty() and size() may be checked without it.
+    SpscRing<Os::KeyPress> keyboardBuffer { 128 * 1024 };
+    std::deque<Os::KeyPress> keyboardOverflow; // pasted keys that did not fit the ring
+    mutable std::mutex keyboardMutex;
+    std::condition_variable keyboardSignal;
+    std::atomic<bool> keyboardMemoryDirty = false; // NDX/KEYD must be re-synced
     SoundSystem* sound = nullptr;
 
 private:
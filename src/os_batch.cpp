@@ -0,0 +1,105 @@
+﻿#include "os_batch.h"
+#include "error.h"
+#include "unicode.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+// a line break is the RETURN key
+static Os::KeyPress keyFromCharacter(char32_t c) {
+    Os::KeyPress key(c);
+    if (c == U'\n') {
+        key.code      = char32_t(Os::KeyConstant::RETURN);
+        key.printable = false;
+    }
+    return key;
+}
+
+bool OsBatch::init(Basic* basic, SoundSystem* sound) {
+    Os::init(basic, sound);
+    screen.setSize(80, 25);
+    start = std::chrono::steady_clock::now();
+
+    // --keys: type the whole file into the keyboard buffer
+    if (!settings.keysFile.empty()) {
+        std::ifstream file(settings.keysFile, std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "%s not found\n", settings.keysFile.c_str());
+            return false;
+        }
+        std::string utf8((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const char* p = utf8.c_str();
+        for (char32_t c = Unicode::parseNextUtf8(p); c != 0; c = Unicode::parseNextUtf8(p)) {
+            if (c != U'\r') {
+                putToKeyboardBuffer(keyFromCharacter(c), false);
+            }
+        }
+    }
+    return true;
+}
+
+// a golden run counts 1 ms per call, so that it prints the same every time
+uint64_t OsBatch::tick() const {
+    if (!settings.goldenFile.empty()) {
+        return ++goldenTick;
+    }
+    return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void OsBatch::delay(int ms) {
+    if (!settings.goldenFile.empty()) {
+        goldenTick += std::max(ms, 0);
+    } else if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+// one UTF-8 character from stdin. Blocks. Reading past the end is an OUT OF DATA error.
+Os::KeyPress OsBatch::getFromKeyboardBuffer() {
+    if (keyboardBufferHasData()) {
+        return Os::getFromKeyboardBuffer();
+    }
+    if (!settings.goldenFile.empty()) {
+        throw BA67::Error(BA67::ErrorId::OUT_OF_DATA); // only the typed keys
+    }
+    fflush(stdout); // show the prompt before waiting
+
+    char utf8[5] = {};
+    int c        = fgetc(stdin);
+    if (c == EOF) {
+        throw BA67::Error(BA67::ErrorId::OUT_OF_DATA);
+    }
+    utf8[0] = char(c);
+    // continuation bytes of a multi-byte sequence
+    size_t length = (c & 0xe0) == 0xc0 ? 2 : (c & 0xf0) == 0xe0 ? 3 : (c & 0xf8) == 0xf0 ? 4 : 1;
+    for (size_t i = 1; i < length; ++i) {
+        c = fgetc(stdin);
+        if (c == EOF) {
+            throw BA67::Error(BA67::ErrorId::OUT_OF_DATA);
+        }
+        utf8[i] = char(c);
+    }
+
+    const char* p = utf8;
+    return keyFromCharacter(Unicode::parseNextUtf8(p));
+}
+
+std::string OsBatch::getHomeDirectory() {
+    return getCurrentDirectory();
+}
+
+std::string OsBatch::getEnv(const std::string& name) {
+    const char* v = getenv(name.c_str());
+    return v ? v : "";
+}
+
+void OsBatch::setEnv(const std::string& name, const std::string& value) {
+#ifdef _WIN32
+    _putenv_s(name.c_str(), value.c_str());
+#else
+    setenv(name.c_str(), value.c_str(), 1);
+#endif
+}
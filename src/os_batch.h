@@ -0,0 +1,33 @@
+#pragma once
+
+#include "os.h"
+#include <chrono>
+
+// Headless backend for --batch.
+// Nothing is rendered or polled. Basic mirrors PRINT to stdout and
+// reads INPUT lines from stdin. GETKEY reads single characters from stdin.
+// The keys of BA68settings::keysFile are typed first.
+class OsBatch : public Os {
+public:
+    OsBatch() = default;
+    bool init(Basic* basic, SoundSystem* sound) override;
+    void updateEvents() override { }
+
+    uint64_t tick() const override;
+    void delay(int ms) override;
+
+    void presentScreen() override { }
+
+    const bool isKeyPressed(char32_t index, bool withShift = false, bool withAlt = false, bool withCtrl = false) const override { return false; }
+    KeyPress getFromKeyboardBuffer() override;
+
+    // stay in the directory BA67 was started from
+    std::string getHomeDirectory() override;
+
+    std::string getEnv(const std::string& name) override;
+    void setEnv(const std::string& name, const std::string& value) override;
+
+private:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    mutable uint64_t goldenTick = 0; // --golden: TI and RND(0) must not depend on the wall clock
+};
@@ -415,15 +415,13 @@ static void renderToFrontBuffer(OsFPL* fpl, OsFPL::Buffered* buffer) {
 // render the screen buffer to the actual graphics screen
 void OsFPL::presentScreen() {
 
-    uint64_t now             = tick();
-    static uint64_t nextShow = 0;
+    uint64_t now = tick();
     if (nextShow > now) {
         return;
     }
     nextShow = now + 5;
 
-    static bool lastCursorBlink = false;
-    bool cursorVisible          = true;
+    bool cursorVisible = true;
     if ((now % 800) < 400) {
         cursorVisible = false;
     }
@@ -434,6 +432,8 @@ void OsFPL::presentScreen() {
 
     if (screen.dirtyFlag) {
         screen.dirtyFlag = false;
+        ++frames;
+        ScopedNanoseconds frameTime(frameNanoseconds, &maxFrameNanoseconds);
 
         // Get window size
         fplWindowSize winSize = {};
@@ -776,10 +776,8 @@ const bool OsFPL::isKeyPressed(char32_t index, bool withShift, bool withAlt, boo
 
     // find cached (even shifted) escape key in keyboard buffer
     if (index == char32_t(KeyConstant::ESCAPE)) {
-        for (auto& k : keyboardBuffer) {
-            if (k.code == char32_t(KeyConstant::ESCAPE)) {
-                return true;
-            }
+        if (keyboardBufferContains(char32_t(KeyConstant::ESCAPE))) {
+            return true;
         }
     }
 
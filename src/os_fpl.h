@@ -19,6 +19,9 @@ private:
     void renderSoftware();
     void renderOpenGL();
 
+    uint64_t nextShow    = 0; // tick of the next frame presentScreen may draw
+    bool lastCursorBlink = false;
+
 public:
     const bool isKeyPressed(char32_t index, bool withShift = false, bool withAlt = false, bool withCtrl = false) const override;
 
@@ -372,6 +372,8 @@ size_t OsPosixConsole::getFreeMemoryInBytes() {
 // Rendering
 // ------------------------------------------------------------
 void OsPosixConsole::presentScreen() {
+    ++frames;
+    ScopedNanoseconds frameTime(frameNanoseconds, &maxFrameNanoseconds);
     printf("%s", screen.updateScreenTerminal(
                            [this](char32_t c) {
                                return mapUnicodeToFontpos(c);
@@ -402,10 +404,8 @@ const bool OsPosixConsole::isKeyPressed(
             escPressed = false;
             return true;
         }
-        for (auto& k : keyboardBuffer) {
-            if (k.code == index) {
-                return true;
-            }
+        if (keyboardBufferContains(index)) {
+            return true;
         }
     }
 
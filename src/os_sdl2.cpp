@@ -147,8 +147,7 @@ void OsSDL2::delay(int ms) {
 // --- SCREEN ---
 void OsSDL2::presentScreen() {
     // TODO in WASM, this function takes about 20 ms on my PC
-    uint64_t now             = tick();
-    static uint64_t nextShow = 0;
+    uint64_t now = tick();
     if (nextShow > now) {
         return;
     }
@@ -157,6 +156,8 @@ void OsSDL2::presentScreen() {
     #else
     nextShow = now + 12;
     #endif
+    ++frames;
+    ScopedNanoseconds frameTime(frameNanoseconds, &maxFrameNanoseconds);
 
     bool cursorVisible = true; // screen.isCursorActive(); // considered in updateScreenPixelsPalette
     if (cursorVisible && (tick() % 800) < 400) {
@@ -241,10 +242,8 @@ const bool OsSDL2::isKeyPressed(char32_t index, bool withShift, bool withAlt, bo
 
     // find cached (even shifted) escape key in keyboard buffer
     if (index == char32_t(KeyConstant::ESCAPE)) {
-        for (auto& k : keyboardBuffer) {
-            if (k.code == char32_t(KeyConstant::ESCAPE)) {
-                return true;
-            }
+        if (keyboardBufferContains(char32_t(KeyConstant::ESCAPE))) {
+            return true;
         }
     }
 
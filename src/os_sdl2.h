@@ -45,6 +45,7 @@ private:
     SDL_Texture* texture   = nullptr;
     bool running           = true;
     int txW, txH; // current texture size
+    uint64_t nextShow = 0; // tick of the next frame presentScreen may draw
 
     static void codepointFromSDLKey(const SDL_Keysym& keysym, Os::KeyPress& k);
 
@@ -150,6 +150,8 @@ size_t OsWindowsConsole::getFreeMemoryInBytes() {
 
 
 void OsWindowsConsole::presentScreen() {
+    ++frames;
+    ScopedNanoseconds frameTime(frameNanoseconds, &maxFrameNanoseconds);
     printf("%s", screen.updateScreenTerminal().c_str());
     fflush(stdout);
 }
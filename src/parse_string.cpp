@@ -1,6 +1,8 @@
 #include "parse_string.h"
 #include "string_helper.h"
 #include "error.h"
+#include <charconv>
+#include <cmath>
 
 namespace BA67 {
 
@@ -23,20 +25,48 @@ const char* skipWhite(const char*& str) {
     return str;
 }
 
-// positive double value
+// double value with an optional sign. Always uses '.' as decimal point.
 bool parseDouble(const char*& str, double* number) {
     skipWhite(str);
 
-    char* end;
-    double d = strtod(str, &end);
-    if (number) {
-        *number = d;
+    const char* p = str;
+    bool negative = false;
+    if (*p == '+' || *p == '-') {
+        negative = *p == '-';
+        ++p;
     }
-    if (end > str) {
-        str = end;
+    // a digit must follow. No INF, NAN or hex numbers.
+    if (isNumeric(*p) || (*p == '.' && isNumeric(p[1]))) {
+        const char* end = p;
+        while (isNumeric(*end) || *end == '.' || *end == 'e' || *end == 'E' || *end == '+' || *end == '-') {
+            ++end;
+        }
+
+        double d = 0.0;
+        auto res = std::from_chars(p, end, d, std::chars_format::general);
+        if (res.ec == std::errc::result_out_of_range) {
+            // strtod semantics: tiny numbers become 0, huge ones infinity
+            bool tiny = false;
+            for (const char* e = p; e < res.ptr; ++e) {
+                if ((*e == 'e' || *e == 'E') && e[1] == '-') {
+                    tiny = true;
+                }
+            }
+            if (!tiny && (*p == '0' || *p == '.')) {
+                tiny = true; // 0.000...1
+            }
+            d = tiny ? 0.0 : HUGE_VAL;
+        }
+        if (number) {
+            *number = negative ? -d : d;
+        }
+        str = res.ptr;
         return true;
     }
 
+    if (number) {
+        *number = 0.0;
+    }
     if (/* options.dotAsZero && */ *str == '.') {
         ++str;
         if (number) {
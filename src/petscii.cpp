@@ -37,7 +37,7 @@ char32_t PETSCII::unicodeFromAltKeyPress(char keyChar, bool withShift) {
             break;
         }
     } else {
-        static uint8_t cbmmap[] = {
+        static const uint8_t cbmmap[] = {
             uint8_t('a'), 0xB0,
             uint8_t('b'), 0xBF,
             uint8_t('c'), 0xBC,
@@ -104,7 +104,7 @@ char32_t PETSCII::toUnicode(uint8_t petscii) {
     // (*) Character is neither upper nor lowercase PETSCII
     // (?) No Unicode pendant was found. See remark
 
-    static char32_t petsciiMapping[256]
+    static const char32_t petsciiMapping[256]
         = {
               /* 0x00, */ 0x00000000, // (-) undefined
               /* 0x01, */ 0x00000001, // (-) undefined
@@ -383,8 +383,9 @@ char32_t PETSCII::toUnicode(uint8_t petscii) {
 }
 
 uint8_t PETSCII::fromUnicode(char32_t c, uint8_t fallback) {
-    static std::unordered_map<char32_t, uint8_t> mapping;
-    if (mapping.empty()) {
+    // built once, thread safe
+    static const std::unordered_map<char32_t, uint8_t> mapping = [] {
+        std::unordered_map<char32_t, uint8_t> mapping;
         // some additional mappings from https://github.com/mist64/c64ref/blob/main/src/charset/C64IPRI.TXT
         // the PET had many glyphs in 1/8th width.
         // The C64/C128 mapping I use, is not really correct
@@ -409,7 +410,8 @@ uint8_t PETSCII::fromUnicode(char32_t c, uint8_t fallback) {
         for (size_t i = 0; i < 0x00ff; ++i) {
             mapping[toUnicode(uint8_t(i & 0xff))] = uint8_t(i & 0xff);
         }
-    }
+        return mapping;
+    }();
     auto it = mapping.find(c);
     if (it == mapping.end()) {
         return fallback;
@@ -421,7 +423,7 @@ uint8_t PETSCII::fromUnicode(char32_t c, uint8_t fallback) {
 
 
 char32_t PETSCII::realPETSCIItoUnicode(uint8_t petscii, bool shiftedFont) {
-    static char32_t unshifted[256]
+    static const char32_t unshifted[256]
         = {
               /* 0x00, */ 0x00000000, // (-) undefined
               /* 0x01, */ 0x00000001, // (-) undefined
@@ -696,7 +698,7 @@ char32_t PETSCII::realPETSCIItoUnicode(uint8_t petscii, bool shiftedFont) {
               /* 0xFF, */ 0x000003C0, // (!) greek small letter pi
           };
 
-    static char32_t shifted[256]
+    static const char32_t shifted[256]
         = {
               /* 0x00, */ 0x00000000, // (-) undefined
               /* 0x01, */ 0x00000001, // (-) undefined
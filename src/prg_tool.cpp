@@ -14,7 +14,7 @@ uint16_t PrgTool::getword(const uint8_t*& p) {
 
 const char* PrgTool::gettoken(const uint8_t*& prg) {
     // https://www.c64-wiki.de/wiki/Token
-    static std::map<int, const char*> tokens = {
+    static const std::map<int, const char*> tokens = {
         {   0x80,      "END" },
         {   0x81,      "FOR" },
         {   0x82,     "NEXT" },
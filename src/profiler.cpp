@@ -0,0 +1,90 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+void Profiler::clear() {
+    lines.clear();
+    keywords.clear();
+    functions.clear();
+    stacks.clear();
+}
+
+void Profiler::addStatement(int32_t line, const std::string& keyword, const std::string& stack, uint64_t ns) {
+    auto& l = lines[line];
+    ++l.count;
+    l.nanoseconds += ns;
+
+    auto& k = keywords[keyword];
+    ++k.count;
+    k.nanoseconds += ns;
+
+    stackKey = stack;
+    stackKey += ';';
+    stackKey += keyword;
+    auto it = stacks.find(stackKey);
+    if (it == stacks.end()) {
+        stacks.emplace(stackKey, ns);
+    } else {
+        it->second += ns;
+    }
+}
+
+void Profiler::addFunction(const std::string& name, uint64_t ns) {
+    auto& f = functions[name];
+    ++f.count;
+    f.nanoseconds += ns;
+}
+
+// "name count ms" rows of the slowest entries
+template <typename Map, typename ToName>
+static void reportTable(std::string& out, const char* title, const Map& map, size_t top, ToName toName) {
+    if (map.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::string, Profiler::Counter>> rows;
+    rows.reserve(map.size());
+    for (auto& it : map) {
+        rows.emplace_back(toName(it.first), it.second);
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        if (a.second.nanoseconds != b.second.nanoseconds) {
+            return a.second.nanoseconds > b.second.nanoseconds;
+        }
+        return a.first < b.first;
+    });
+    if (rows.size() > top) {
+        rows.resize(top);
+    }
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%-8s %10s %10s\n", title, "COUNT", "MS");
+    out += buf;
+    for (auto& r : rows) {
+        snprintf(buf, sizeof(buf), "%-8s %10llu %10.3f\n", r.first.c_str(), (unsigned long long)r.second.count, double(r.second.nanoseconds) / 1.0e6);
+        out += buf;
+    }
+}
+
+std::string Profiler::report(size_t top) const {
+    std::string out;
+    reportTable(out, "LINE", lines, top, [](int32_t line) { return line < 0 ? std::string("DIRECT") : std::to_string(line); });
+    reportTable(out, "KEYWORD", keywords, top, [](const std::string& s) { return s; });
+    reportTable(out, "FUNCTION", functions, top, [](const std::string& s) { return s; });
+    return out;
+}
+
+std::string Profiler::collapsedStacks() const {
+    // sorted, so the same run gives the same file
+    std::vector<std::pair<std::string, uint64_t>> rows(stacks.begin(), stacks.end());
+    std::sort(rows.begin(), rows.end());
+
+    std::string out;
+    for (auto& r : rows) {
+        out += r.first;
+        out += ' ';
+        out += std::to_string(r.second);
+        out += '\n';
+    }
+    return out;
+}
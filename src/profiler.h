@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// PROFILE ON: where a BASIC program spends its time.
+// Each statement is timed on its own and added to its line number,
+// its keyword and its GOSUB call stack. Built-in functions are timed
+// separately (including the time of their arguments' functions).
+class Profiler {
+public:
+    struct Counter {
+        uint64_t count       = 0;
+        uint64_t nanoseconds = 0;
+    };
+
+    bool on = false;
+
+    static uint64_t now() {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void clear();
+
+    // stack is "main;30;100" - the frames up to (excluding) the keyword
+    void addStatement(int32_t line, const std::string& keyword, const std::string& stack, uint64_t ns);
+    void addFunction(const std::string& name, uint64_t ns);
+
+    // the slowest lines, keywords and functions as text
+    std::string report(size_t top) const;
+
+    // one "frame;frame;leaf nanoseconds" line per call stack, as read by flamegraph.pl
+    std::string collapsedStacks() const;
+
+private:
+    std::unordered_map<int32_t, Counter> lines;
+    std::unordered_map<std::string, Counter> keywords;
+    std::unordered_map<std::string, Counter> functions;
+    std::unordered_map<std::string, uint64_t> stacks;
+    std::string stackKey; // reused, so a known stack does not allocate
+};
@@ -6,11 +6,6 @@
 #include <cstring>
 #include "unicode.h"
 
-static CharMap& charMap() {
-    static CharMap c;
-    return c;
-}
-
 
 // ------------------------------------------------------------------
 
@@ -124,7 +119,6 @@ ScreenBuffer::Cursor ScreenBuffer::getEndOfLineAt(Cursor crsr) {
 }
 
 ScreenBuffer::ScreenBuffer() {
-    charMap(); // load bitmaps
     palette = {};
 }
 
@@ -148,9 +142,6 @@ void ScreenBuffer::initMemory(RomImage& image) {
     setColors(1, 0);
     setBorderColor(1);
     setReverseMode(false);
-
-    overflowTop.reserve(0x10000);
-    overflowBottom.reserve(0x10000);
 }
 
 
@@ -190,22 +181,7 @@ void ScreenBuffer::updateScreenPixelsPalette(bool highlightCursor, std::vector<u
         }
     }
 
-    // sprites
-    for (auto& sp : sprites) {
-        if (!sp.enabled) {
-            continue;
-        }
-
-        // C64/C128 sprite coordinates are relative to the screen - 0,0 is in the border
-        const int sprbx = 25;
-        const int sprby = 50;
-        drawSprPal(pixelsPal, sp.x + 0 - sprbx, sp.y - sprby, sp.charmap[0], sp.color);
-        drawSprPal(pixelsPal, sp.x + 8 - sprbx, sp.y - sprby, sp.charmap[1], sp.color);
-        drawSprPal(pixelsPal, sp.x + 16 - sprbx, sp.y - sprby, sp.charmap[2], sp.color);
-        drawSprPal(pixelsPal, sp.x + 0 - sprbx, sp.y + 8 - sprby, sp.charmap[3], sp.color);
-        drawSprPal(pixelsPal, sp.x + 8 - sprbx, sp.y + 8 - sprby, sp.charmap[4], sp.color);
-        drawSprPal(pixelsPal, sp.x + 16 - sprbx, sp.y + 8 - sprby, sp.charmap[5], sp.color);
-    }
+    compositeSprites(&pixelsPal);
 }
 
 // update the RGB buffer
@@ -660,16 +636,16 @@ void ScreenBuffer::resetDefaultColors() {
 }
 
 void ScreenBuffer::resetCharmap(char32_t from, char32_t to) {
-    charMap().init(from, to);
-    charMap().createColorControlCodes();
+    charMap.init(from, to);
+    charMap.createColorControlCodes();
 }
 void ScreenBuffer::defineChar(char32_t codePoint, const CharBitmap& bits) {
-    dirtyFlag               = true;
-    charMap().at(codePoint) = bits;
+    dirtyFlag             = true;
+    charMap.at(codePoint) = bits;
 }
 
 const CharBitmap& ScreenBuffer::getCharDefinition(char32_t codePoint) const {
-    return charMap()[codePoint];
+    return charMap[codePoint];
 }
 
 void ScreenBuffer::chrout(char32_t c) {
@@ -706,6 +682,42 @@ void ScreenBuffer::chrout(char32_t c) {
     }
 }
 
+void ScreenBuffer::chrout(const char32_t* str, size_t length) {
+    if (!charRam || !lineLinkTable) {
+        return;
+    }
+
+    dirtyFlag           = true;
+    const char32_t* end = str + length;
+    while (str < end) {
+        if (*str == U'\r' || *str == U'\n' || *str == U'\b') {
+            chrout(*str++);
+            continue;
+        }
+
+        // the rest of the cursor row, up to the next special character
+        Cursor crsr     = getCursorPos();
+        size_t n        = 0;
+        size_t maxCount = std::min(size_t(end - str), width - crsr.x);
+        while (n < maxCount && str[n] != U'\r' && str[n] != U'\n' && str[n] != U'\b') {
+            ++n;
+        }
+
+        size_t idx = crsr.x + width * crsr.y;
+        std::copy(str, str + n, charRam + idx);
+        if (colRam) {
+            std::fill(colRam + idx, colRam + idx + n, currentColor());
+        }
+        str += n;
+
+        if (crsr.x + n < width) {
+            setCursorPos({ crsr.x + n, crsr.y });
+        } else {
+            softWrapToNextRow();
+        }
+    }
+}
+
 void ScreenBuffer::deleteChar() {
     if (!charRam) {
         return;
@@ -921,16 +933,7 @@ void ScreenBuffer::insertNewEmptyLine(int lineIndex) {
     const size_t rowCellCount = width;
 
     // keep top line in overflow buffer
-    LineOverflow ovr;
-    ovr.setWidth(width);
-    for (size_t c = 0; c < width; ++c) {
-        ovr.characters[c] = charRam[c];
-        if (colRam) {
-            ovr.colors[c] = colRam[c];
-        }
-    }
-    ovr.lineLink = lineLinkTable[0];
-    overflowTop.push_back(ovr);
+    overflowTop.push(charRam, colRam, width, lineLinkTable[0]);
 
     ++scrollCount;
     std::memmove(charRam, charRam + rowCellCount, (lineIndex)*rowCellCount * sizeof(MEMCELL));
@@ -952,16 +955,7 @@ void ScreenBuffer::scrollUpOne() {
     const size_t rowCellCount = width;
 
     // keep top line in overflow buffer
-    LineOverflow ovr;
-    ovr.setWidth(width);
-    for (size_t c = 0; c < width; ++c) {
-        ovr.characters[c] = charRam[c];
-        if (colRam) {
-            ovr.colors[c] = colRam[c];
-        }
-    }
-    ovr.lineLink = lineLinkTable[0];
-    overflowTop.push_back(ovr);
+    overflowTop.push(charRam, colRam, width, lineLinkTable[0]);
 
     ++scrollCount;
     std::memmove(charRam, charRam + rowCellCount, (height - 1) * rowCellCount * sizeof(MEMCELL));
@@ -971,10 +965,10 @@ void ScreenBuffer::scrollUpOne() {
     MEMCELL curCol = currentColor();
     for (size_t c = 0; c < width; ++c) {
         const size_t index = (height - 1) * width + c;
-        if (!overflowBottom.empty() && c < overflowBottom.back().width()) {
-            charRam[index] = overflowBottom.back().characters[c];
+        if (!overflowBottom.empty() && c < overflowBottom.width()) {
+            charRam[index] = overflowBottom.character(c);
             if (colRam) {
-                colRam[index] = overflowBottom.back().colors[c];
+                colRam[index] = overflowBottom.color(c);
             }
         } else {
             charRam[index] = blankChar;
@@ -991,8 +985,8 @@ void ScreenBuffer::scrollUpOne() {
     if (overflowBottom.empty()) { 
         lineLinkTable[height - 1] = 0x80;
     }else{
-        lineLinkTable[height - 1] = overflowBottom.back().lineLink;
-        overflowBottom.pop_back();
+        lineLinkTable[height - 1] = overflowBottom.lineLink();
+        overflowBottom.pop();
     }
     rebuildLineLinkAddresses();
 
@@ -1007,17 +1001,8 @@ void ScreenBuffer::scrollUpOne() {
 void ScreenBuffer::scrollDownOne() {
     const size_t rowCellCount = width;
     // keep in overflow buffer
-    LineOverflow ovr;
-    ovr.setWidth(width);
-    for (size_t c = 0; c < width; ++c) {
-        const size_t index = c + ((height - 1) * rowCellCount);
-        ovr.characters[c]  = charRam[index];
-        if (colRam) {
-            ovr.colors[c] = colRam[index];
-        }
-    }
-    ovr.lineLink = lineLinkTable[height - 1];
-    overflowBottom.push_back(ovr);
+    const size_t bottom = (height - 1) * rowCellCount;
+    overflowBottom.push(charRam + bottom, colRam ? colRam + bottom : nullptr, width, lineLinkTable[height - 1]);
 
     ++scrollCount;
     std::memmove(charRam + rowCellCount, charRam, (height - 1) * rowCellCount * sizeof(MEMCELL));
@@ -1026,10 +1011,10 @@ void ScreenBuffer::scrollDownOne() {
     }
     MEMCELL curCol = currentColor();
     for (size_t c = 0; c < width; ++c) {
-        if (!overflowTop.empty() && c < overflowTop.back().width()) {
-            charRam[c] = overflowTop.back().characters[c];
+        if (!overflowTop.empty() && c < overflowTop.width()) {
+            charRam[c] = overflowTop.character(c);
             if (colRam) {
-                colRam[c] = overflowTop.back().colors[c];
+                colRam[c] = overflowTop.color(c);
             }
         } else {
             charRam[c] = blankChar;
@@ -1044,8 +1029,8 @@ void ScreenBuffer::scrollDownOne() {
     }
 
     if (!overflowTop.empty()) {
-        lineLinkTable[0] = overflowTop.back().lineLink;
-        overflowTop.pop_back();
+        lineLinkTable[0] = overflowTop.lineLink();
+        overflowTop.pop();
     }
     rebuildLineLinkAddresses();
 
@@ -1064,7 +1049,7 @@ void ScreenBuffer::clearHistory() {
 
 // draw character pixels at given pixel position
 void ScreenBuffer::drawCharPal(std::vector<uint8_t>& pixels, size_t x, size_t y, char32_t ch, uint8_t colIxText, uint8_t colIxBack, bool inverse) {
-    const CharBitmap& img = charMap()[ch];
+    const CharBitmap& img = charMap[ch];
 
     // Calculate starting pixel index in the pixels array
     size_t pixelX = x; // * ScreenInfo::charPixX;
@@ -1104,11 +1089,92 @@ void ScreenBuffer::drawCharPal(std::vector<uint8_t>& pixels, size_t x, size_t y,
     }
 }
 
-void ScreenBuffer::drawSprPal(std::vector<uint8_t>& pixels, int64_t x, int64_t y, char32_t chimg, int8_t color) {
+void ScreenBuffer::updateActiveSprites() {
+    activeSpriteList.clear();
+    for (size_t n = 1; n < sprites.size(); ++n) {
+        if (sprites[n].enabled) {
+            activeSpriteList.push_back(uint8_t(n));
+        }
+    }
+    std::stable_sort(activeSpriteList.begin(), activeSpriteList.end(), [this](uint8_t a, uint8_t b) {
+        return sprites[a].behindText && !sprites[b].behindText;
+    });
+    dirtyFlag      = true;
+    spritesChanged = true;
+}
+
+void ScreenBuffer::compositeSprites(std::vector<uint8_t>* pixels) {
+    spritesChanged = false;
+    spriteContacts.reset();
+    backgroundContacts.reset();
+    if (activeSpriteList.empty()) {
+        return;
+    }
+    // the buffer is all 0 between calls. Only a new screen size allocates it.
+    const int64_t scPixW = width * ScreenInfo::charPixX;
+    const int64_t scPixH = height * ScreenInfo::charPixY;
+    if (spritePixelOwner.size() != size_t(scPixW * scPixH)) {
+        spritePixelOwner.assign(size_t(scPixW * scPixH), 0);
+    }
+
+    // C64/C128 sprite coordinates are relative to the screen - 0,0 is in the border
+    const int sprbx = 25;
+    const int sprby = 50;
+    for (uint8_t n : activeSpriteList) {
+        const Sprite& sp = sprites[n];
+        for (int i = 0; i < 6; ++i) {
+            drawSprPal(pixels, sp.x + (i % 3) * 8 - sprbx, sp.y + (i / 3) * 8 - sprby, sp.charmap[i], sp.color, n, sp.behindText);
+        }
+    }
+    // clear the 24x16 pixels of each sprite instead of the whole buffer
+    for (uint8_t n : activeSpriteList) {
+        const Sprite& sp = sprites[n];
+        int64_t x0       = std::max<int64_t>(sp.x - sprbx, 0);
+        int64_t x1       = std::min<int64_t>(sp.x - sprbx + 24, scPixW);
+        int64_t y0       = std::max<int64_t>(sp.y - sprby, 0);
+        int64_t y1       = std::min<int64_t>(sp.y - sprby + 16, scPixH);
+        for (int64_t y = y0; y < y1 && x0 < x1; ++y) {
+            std::fill_n(spritePixelOwner.begin() + (y * scPixW + x0), x1 - x0, uint8_t(0));
+        }
+    }
+    spriteCollisions |= spriteContacts;
+    backgroundCollisions |= backgroundContacts;
+}
+
+bool ScreenBuffer::isTextPixel(size_t px, size_t py) const {
+    size_t cell           = (py / ScreenInfo::charPixY) * width + px / ScreenInfo::charPixX;
+    const CharBitmap& img = charMap[charRam[cell]];
+    size_t row            = py % ScreenInfo::charPixY;
+    size_t col            = px % ScreenInfo::charPixX;
+    if (img.isMono) {
+        return ((img.bits[row] >> (7 - col)) & 1) != 0;
+    }
+    return img.multi(row * ScreenInfo::charPixX + col) != ((colRam[cell] >> 4) & 0x0f);
+}
+
+void ScreenBuffer::plotSpritePixel(std::vector<uint8_t>* pixels, size_t px, size_t py, uint8_t color, uint8_t spriteNumber, bool behindText) {
+    size_t pixelIndex = py * width * ScreenInfo::charPixX + px;
+    uint8_t& owner    = spritePixelOwner[pixelIndex];
+    if (owner != 0 && owner != spriteNumber) {
+        spriteContacts.set(owner);
+        spriteContacts.set(spriteNumber);
+    }
+    owner = spriteNumber;
+
+    bool onText = isTextPixel(px, py);
+    if (onText) {
+        backgroundContacts.set(spriteNumber);
+    }
+    if (pixels != nullptr && !(behindText && onText)) {
+        (*pixels)[pixelIndex] = color;
+    }
+}
+
+void ScreenBuffer::drawSprPal(std::vector<uint8_t>* pixels, int64_t x, int64_t y, char32_t chimg, int8_t color, uint8_t spriteNumber, bool behindText) {
     if (chimg == 0) {
         return;
     }
-    const CharBitmap& img = charMap()[chimg];
+    const CharBitmap& img = charMap[chimg];
 
     int64_t scPixW = width * ScreenInfo::charPixX;
     int64_t scPixH = height * ScreenInfo::charPixY;
@@ -1126,14 +1192,12 @@ void ScreenBuffer::drawSprPal(std::vector<uint8_t>& pixels, int64_t x, int64_t y
                 if (px < 0 || py < 0 || px >= scPixW || py >= scPixH) {
                     continue;
                 }
-                size_t pixelIndex  = py * scPixW + px;
-                pixels[pixelIndex] = color;
+                plotSpritePixel(pixels, size_t(px), size_t(py), color, spriteNumber, behindText);
             }
         }
     } else {
         size_t nth = 0;
         for (int64_t row = 0; row < ScreenInfo::charPixY; ++row) {
-            uint8_t pixelRow = img.bits[row]; // Each byte represents 8 pixels in a row
             static_assert(ScreenInfo::charPixX == 8, "the pixel bytes are wrong, otherwise");
             for (int64_t col = 0; col < ScreenInfo::charPixX; ++col) {
                 uint8_t pxcol = img.multi(nth++);
@@ -1146,8 +1210,7 @@ void ScreenBuffer::drawSprPal(std::vector<uint8_t>& pixels, int64_t x, int64_t y
                 if (px < 0 || py < 0 || px >= scPixW || py >= scPixH) {
                     continue;
                 }
-                size_t pixelIndex  = py * scPixW + px;
-                pixels[pixelIndex] = pxcol;
+                plotSpritePixel(pixels, size_t(px), size_t(py), pxcol, spriteNumber, behindText);
             }
         }
     }
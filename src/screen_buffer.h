@@ -1,7 +1,9 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
 // #include <iostream>
 #include <array>
+#include <bitset>
 // #include <unordered_map>
 // #include <memory>
 #include <mutex>
@@ -20,6 +22,7 @@ public:
 
     bool stretchX = false, stretchY = false;
     bool enabled = false;
+    bool behindText = false; // SPRITE priority 1: the text is drawn over the sprite
 };
 
 using MEMCELL = uint32_t; // what a peek/poke address points to
@@ -173,6 +176,20 @@ public:
     std::array<uint32_t, 16> palette; // AABBGGRR little endian format
     std::array<Sprite, 256> sprites;
 
+    // the enabled sprite numbers in drawing order, the ones behind the text first.
+    // Call updateActiveSprites() after enabling a sprite or changing its priority.
+    const std::vector<uint8_t>& activeSprites() const { return activeSpriteList; }
+    void updateActiveSprites();
+
+    // Pixel accurate collisions by sprite number. Like the VIC-II registers
+    // $D01E and $D01F the bits stay set until they are read with BUMP.
+    // Collisions are found while the sprites are drawn or by detectCollisions().
+    std::bitset<256> spriteCollisions, backgroundCollisions;
+    // the sprites that touched at the last detection, not latched
+    std::bitset<256> spriteContacts, backgroundContacts;
+    void detectCollisions() { compositeSprites(nullptr); }
+    bool spritesChanged = true; // a sprite was defined, switched or moved since the last detection
+
     // save/restore screen for emoji picker etc.
     struct SaveState {
         std::vector<MEMCELL> chars;
@@ -231,17 +248,71 @@ private:
     MEMCELL blankChar    = U' ';
     MEMCELL defaultColor = 1;
 
-    struct LineOverflow {
-        void setWidth(size_t width) {
-            characters.resize(width);
-            colors.resize(width);
+    // Lines scrolled out of the screen. A stack with a fixed number of
+    // slots: when it's full, a push overwrites the oldest line.
+    // The slots are allocated once, scrolling does not allocate.
+    class LineOverflow {
+    public:
+        void setDepth(size_t lines) {
+            depth = lines;
+            clear();
+            slotWidth = 0;
+        }
+        void clear() {
+            first = 0;
+            count = 0;
         }
-        size_t width() const { return characters.size(); }
-        std::vector<MEMCELL> characters;
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+
+        void push(const MEMCELL* chars, const MEMCELL* colors, size_t width, MEMCELL lineLink) {
+            if (depth == 0) {
+                return;
+            }
+            if (width > slotWidth) { // first push or wider screen
+                slotWidth = width;
+                characters.assign(depth * slotWidth, U' ');
+                this->colors.assign(depth * slotWidth, 0);
+                slots.assign(depth, Slot {});
+                clear();
+            }
+            size_t s;
+            if (count < depth) {
+                s = (first + count++) % depth;
+            } else {
+                s     = first; // drop the oldest line
+                first = (first + 1) % depth;
+            }
+            slots[s] = { width, lineLink };
+            std::copy(chars, chars + width, characters.begin() + s * slotWidth);
+            for (size_t c = 0; c < width; ++c) {
+                this->colors[s * slotWidth + c] = uint8_t(colors ? colors[c] : 0);
+            }
+        }
+        void pop() { --count; }
+
+        // the newest line
+        size_t width() const { return slots[back()].width; }
+        MEMCELL lineLink() const { return slots[back()].lineLink; }
+        MEMCELL character(size_t c) const { return characters[back() * slotWidth + c]; }
+        MEMCELL color(size_t c) const { return colors[back() * slotWidth + c]; }
+
+    private:
+        struct Slot {
+            size_t width     = 0;
+            MEMCELL lineLink = 0;
+        };
+        size_t back() const { return (first + count - 1) % depth; }
+
+        std::vector<MEMCELL> characters; // depth * slotWidth
         std::vector<uint8_t> colors;
-        MEMCELL lineLink=0;
+        std::vector<Slot> slots;
+        size_t depth     = 1000;
+        size_t slotWidth = 0;
+        size_t first     = 0; // oldest line
+        size_t count     = 0;
     };
-    std::vector<LineOverflow> overflowTop, overflowBottom;
+    LineOverflow overflowTop, overflowBottom;
 
 
     inline void assertCursor() {
@@ -267,6 +338,8 @@ public:
     }
 
     void chrout(char32_t c);
+    // print a run of characters. Copies row segments, only newline and backspace go through chrout(c).
+    void chrout(const char32_t* str, size_t length);
 
     void deleteChar();
     void backspaceChar();
@@ -277,6 +350,11 @@ public:
     void scrollDownOne();
 
     void clearHistory();
+    // number of lines kept above and below the screen
+    void setScrollbackDepth(size_t lines) {
+        overflowTop.setDepth(lines);
+        overflowBottom.setDepth(lines);
+    }
 
     inline bool isOwnerRow(size_t r) const { return (lineLinkTable[r] & 0x80) != 0; }
     inline bool isContinuationRow(size_t r) const { return (lineLinkTable[r] & 0x80) == 0; }
@@ -322,6 +400,7 @@ private:
 
 protected:
     mutable std::mutex lock;
+    CharMap charMap; // glyphs. CHARDEF changes them for this screen only
 
     // get colRam value for current text and background colors
     inline MEMCELL currentColor() const {
@@ -337,7 +416,15 @@ protected:
     // draw character at given character position
     // colText and colBack are the AABBGGRR values of the pixels.
     void drawCharPal(std::vector<uint8_t>& pixels, size_t x, size_t y, char32_t ch, uint8_t colText, uint8_t colBack, bool inverse);
-    void drawSprPal(std::vector<uint8_t>& pixels, int64_t x, int64_t y, char32_t chimg, int8_t color);
+    void drawSprPal(std::vector<uint8_t>* pixels, int64_t x, int64_t y, char32_t chimg, int8_t color, uint8_t spriteNumber, bool behindText);
+    void plotSpritePixel(std::vector<uint8_t>* pixels, size_t px, size_t py, uint8_t color, uint8_t spriteNumber, bool behindText);
+    // draw the active sprites to pixels (if not nullptr) and record the collisions
+    void compositeSprites(std::vector<uint8_t>* pixels);
+    // the pixel of the text layer is set (not background)
+    bool isTextPixel(size_t px, size_t py) const;
+
+    std::vector<uint8_t> activeSpriteList;
+    std::vector<uint8_t> spritePixelOwner; // sprite number per screen pixel while compositing
     void drawLineContinuationPal(std::vector<uint8_t>& pixels, size_t yline);
 
 public:
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed capacity single producer / single consumer ring buffer.
+// One thread may push() while another one pops, peeks and scans
+// without any locking. The capacity must be a power of two.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : items(capacity)
+        , mask(capacity - 1) { }
+    SpscRing(const SpscRing&)            = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // producer side. Returns false if the buffer is full.
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= items.size()) {
+            return false;
+        }
+        items[h & mask] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+    // index 0 is the oldest item. Consumer side only.
+    const T& at(size_t index) const { return items[(tail.load(std::memory_order_relaxed) + index) & mask]; }
+    const T& front() const { return at(0); }
+
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return items.size(); }
+
+private:
+    std::vector<T> items;
+    size_t mask;
+    std::atomic<size_t> head = 0; // next write position
+    std::atomic<size_t> tail = 0; // next read position
+};
@@ -23,6 +23,7 @@ enum class TokenType {
     PARENTHESIS, // ( )
     MODULE,
     FILEHANDLE, // #1
+    PARAMETER, // DEF FN parameter in the function body. tv = parameter index
 
     END
 };
@@ -32,6 +33,8 @@ struct Token {
     TokenType type = TokenType::END;
     std::string_view valueForDebugging;
     Value tv;
+    mutable int32_t lineSlot = -1; // GOTO 100: cached index into Module::lineIndex
+    int32_t systemVariable   = -1; // IDENTIFIER: index into Basic::systemVariables (TI, ST,...), set by the tokenizer
 
 
 private:
@@ -0,0 +1,47 @@
+#include "trace_ring.h"
+
+void TraceRing::assign(int32_t line, const void* module, std::string_view name, const BA67::Value& value) {
+    if (events.empty()) {
+        return;
+    }
+    Event& e = events[next++ % capacity];
+    e.line   = line;
+    e.module = module;
+    copyCut(e.name, name);
+    if (auto* s = std::get_if<std::string>(&value)) {
+        e.kind = Event::Kind::STRING;
+        copyCut(e.text, *s);
+    } else {
+        e.kind   = Event::Kind::NUMBER;
+        e.number = BA67::ValueToDoubleOrZero(value);
+    }
+}
+
+std::string TraceRing::text(const std::function<std::string(const void* module)>& moduleName) const {
+    std::string out;
+    for (uint64_t i = next - size(); i < next; ++i) {
+        const Event& e = events[i % capacity];
+
+        std::string mod = moduleName(e.module);
+        if (!mod.empty()) {
+            out += mod + ":";
+        }
+        out += std::to_string(e.line) + " ";
+        switch (e.kind) {
+        case Event::Kind::STATEMENT:
+            out += e.name;
+            break;
+        case Event::Kind::NUMBER:
+            {
+                char buf[BA67::NumberTextSize];
+                out += std::string(e.name) + " = " + std::string(buf, BA67::NumberToChars(e.number, buf));
+            }
+            break;
+        case Event::Kind::STRING:
+            out += std::string(e.name) + " = \"" + e.text + "\"";
+            break;
+        }
+        out += "\n";
+    }
+    return out;
+}
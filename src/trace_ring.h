@@ -0,0 +1,68 @@
+#pragma once
+#include "value.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// TRON: the last statements and variable writes in a fixed size ring.
+// Recording an event is a few stores and never allocates, so tracing does
+// not change the timing of the program. The text is made when dumping.
+class TraceRing {
+public:
+    static constexpr size_t capacity = 4096;
+
+    struct Event {
+        enum class Kind : uint8_t { STATEMENT,
+                                    NUMBER,
+                                    STRING };
+        Kind kind          = Kind::STATEMENT;
+        int32_t line       = 0;
+        const void* module = nullptr; // Basic::Module, resolved to its name when dumping
+        char name[16]      = {}; // keyword or variable name, cut off
+        double number      = 0.0;
+        char text[24]      = {}; // string value, cut off
+    };
+
+    bool variables = false; // also record assignments
+    std::string file; // dumped here on errors and TROFF
+
+    void start() {
+        events.resize(capacity);
+        next = 0;
+    }
+    void stop() {
+        events.clear();
+        events.shrink_to_fit();
+        next = 0;
+    }
+    bool running() const { return !events.empty(); }
+    size_t size() const { return next < capacity ? size_t(next) : capacity; }
+
+    void statement(int32_t line, const void* module, std::string_view keyword) {
+        if (events.empty()) {
+            return;
+        }
+        Event& e = events[next++ % capacity];
+        e.kind   = Event::Kind::STATEMENT;
+        e.line   = line;
+        e.module = module;
+        copyCut(e.name, keyword);
+    }
+    void assign(int32_t line, const void* module, std::string_view name, const BA67::Value& value);
+
+    // oldest event first, one per line
+    std::string text(const std::function<std::string(const void* module)>& moduleName) const;
+
+private:
+    std::vector<Event> events;
+    uint64_t next = 0; // events recorded since start()
+
+    template <size_t N>
+    static void copyCut(char (&dst)[N], std::string_view src) {
+        size_t n = src.size() < N - 1 ? src.size() : N - 1;
+        src.copy(dst, n);
+        dst[n] = '\0';
+    }
+};
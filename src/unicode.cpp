@@ -1,5 +1,7 @@
 #include "unicode.h"
+#include <algorithm>
 #include <codecvt>
+#include <cstdint>
 #include <cstring>
 #include <locale>
 #include "string_helper.h"
@@ -188,10 +190,15 @@ size_t Unicode::utf8StrLen(const char* utf8) {
 // Get length of utf8 string in Unicode code points.
 // This version even works with null characters.
 size_t Unicode::utf8StrLen(const std::string& utf8) {
-    const char* ptr = utf8.c_str();
-    const char* end = ptr + utf8.length();
+    return utf8StrLen(utf8.c_str(), utf8.length());
+}
+
+size_t Unicode::utf8StrLen(const char* utf8, size_t length) {
+    // an ASCII run is one code point per byte
+    size_t len      = asciiPrefixLength(utf8, length);
+    const char* ptr = utf8 + len;
+    const char* end = utf8 + length;
 
-    size_t len = 0;
     while (ptr < end) {
         if (*ptr == '\0') {
             ++ptr;
@@ -203,6 +210,46 @@ size_t Unicode::utf8StrLen(const std::string& utf8) {
     return len;
 }
 
+size_t Unicode::asciiPrefixLength(const char* str, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, str + i, 8);
+        if ((word & 0x8080808080808080ULL) != 0) {
+            break;
+        }
+    }
+    while (i < length && static_cast<unsigned char>(str[i]) < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+size_t Unicode::byteOffset(const std::string& utf8, size_t codePoint, size_t from) {
+    const size_t length = utf8.length();
+    if (from >= length) {
+        return length;
+    }
+    size_t ascii = asciiPrefixLength(utf8.c_str() + from, std::min(codePoint, length - from));
+    codePoint -= ascii;
+
+    const char* begin = utf8.c_str();
+    const char* end   = begin + length;
+    const char* str   = begin + from + ascii;
+    while (codePoint > 0 && str < end) {
+        if (static_cast<unsigned char>(*str) < 0x80) {
+            ++str; // ASCII or null character
+        } else {
+            const char* invalid = str;
+            if (parseNextUtf8(str) == 0) {
+                return size_t(invalid - begin);
+            }
+        }
+        --codePoint;
+    }
+    return size_t(str - begin);
+}
+
 // uppercase a Unicode character, but only A-Z characters
 char32_t Unicode::toUpperAscii(char32_t c) {
     if (c >= 'a' && c <= 'z') {
@@ -347,67 +394,24 @@ std::string::size_type Unicode::strstr(const std::string& utf8, const std::strin
         return 0; // Empty substring matches at start
     }
 
-    const char* search = utf8.c_str();
-    const char* target = utf8Find.c_str();
-
-    // Advance search to startCodePoint
-    size_t currentCodePoint = 0;
-    while (*search && currentCodePoint < startCodePoint) {
-        if (!parseNextUtf8(search)) {
-            return std::string::npos;
-        }
-        currentCodePoint++;
+    size_t from = byteOffset(utf8, startCodePoint);
+    if (from >= utf8.length()) {
+        return std::string::npos;
     }
 
-    while (*search) {
-        const char* searchPos = search;
-        const char* findPos   = target;
-
-        while (*findPos) {
-            const char* tempSearch = searchPos;
-            char32_t searchCp      = parseNextUtf8(tempSearch);
-            char32_t findCp        = parseNextUtf8(findPos);
-
-            if (searchCp == 0 || searchCp != findCp) {
-                break;
-            }
-            searchPos = tempSearch;
-        }
-
-        if (*findPos == '\0') { // Found match
-            return currentCodePoint; // search - utf8.c_str();
-        }
-
-        // Move to next code point in search string
-        if (!parseNextUtf8(search)) {
-            break;
-        }
-        ++currentCodePoint;
+    // UTF-8 is self-synchronizing: a byte match always starts at a code point
+    size_t pos = utf8.find(utf8Find, from);
+    if (pos == std::string::npos) {
+        return std::string::npos;
     }
-
-    return std::string::npos;
+    return startCodePoint + utf8StrLen(utf8.c_str() + from, pos - from);
 }
 
 // return substring. Can deal with null characters.
 std::string Unicode::substr(const std::string& utf8, size_t startCodePoint, size_t length) {
-    std::string rv;
-    const char* str = utf8.c_str();
-    const char* end = str + utf8.length();
-    for (size_t i = 0; str != end; ++i) {
-        char32_t c = 0;
-        if (*str == '\0') {
-            ++str;
-        } else {
-            c = parseNextUtf8(str);
-            if (c == 0) {
-                break;
-            }
-        }
-        if (i >= startCodePoint && i - startCodePoint < length) {
-            appendAsUtf8(rv, c);
-        }
-    }
-    return rv;
+    size_t begin = byteOffset(utf8, startCodePoint);
+    size_t end   = byteOffset(utf8, length, begin);
+    return utf8.substr(begin, end - begin);
 }
 
 // check if a wildcard pattern matches a string
@@ -20,6 +20,13 @@ public:
     // code point length of utf8 string
     static size_t utf8StrLen(const char* utf8);
     static size_t utf8StrLen(const std::string& utf8);
+    static size_t utf8StrLen(const char* utf8, size_t length); // counts null characters, too
+
+    // number of leading 7 bit ASCII bytes. Tests 8 bytes at a time.
+    static size_t asciiPrefixLength(const char* str, size_t length);
+    // byte offset of the code point with index codePoint, counted from the byte offset 'from'.
+    // Stops at the end of the string or at an invalid sequence.
+    static size_t byteOffset(const std::string& utf8, size_t codePoint, size_t from = 0);
 
     // uppercase a Unicode code point (A-Z)
     static char32_t toUpperAscii(char32_t c);
@@ -1,8 +1,6 @@
 #include "value.h"
 #include "error.h"
-#include <iostream>
-#include <sstream>
-#include <iomanip>
+#include <charconv>
 #include "parse_string.h"
 
 using namespace BA67;
@@ -13,22 +11,27 @@ std::string ValueToString(const Value& v) {
     if (auto s = std::get_if<std::string>(&v)) {
         return *s;
     }
+    char buf[NumberTextSize];
     if (auto i = std::get_if<int64_t>(&v)) {
-        return std::to_string(*i);
+        return std::string(buf, NumberToChars(*i, buf));
     }
     if (auto d = std::get_if<double>(&v)) {
-#if defined(__cplusplus) && __cplusplus > 202002L
-        return return std::format("{:.9g}", *d);
-#else
-        std::ostringstream oss;
-        oss << std::setprecision(9) << std::noshowpoint << *d;
-        return oss.str();
-#endif
-        return std::to_string(*d);
+        return std::string(buf, NumberToChars(*d, buf));
     }
     throw Error(ErrorId::TYPE_MISMATCH);
 }
 
+// 9 significant digits, E notation from 1e9 and below 1e-4, like "%.9g"
+size_t NumberToChars(double d, char* buffer) {
+    auto res = std::to_chars(buffer, buffer + NumberTextSize, d, std::chars_format::general, 9);
+    return size_t(res.ptr - buffer);
+}
+
+size_t NumberToChars(int64_t i, char* buffer) {
+    auto res = std::to_chars(buffer, buffer + NumberTextSize, i);
+    return size_t(res.ptr - buffer);
+}
+
 double ValueToDouble(const Value& v) {
     if (auto i = std::get_if<int64_t>(&v)) {
         return (double)(*i);
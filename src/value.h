@@ -63,6 +63,12 @@ using Value = std::variant<int64_t, double, std::string, Operator>;
 
     // Represent value as string
 std::string ValueToString(const Value& v);
+
+// Number as text like printf("%.9g"), without locale and heap.
+// The buffer needs NumberTextSize bytes. Returns the length, no terminating 0.
+constexpr size_t NumberTextSize = 32;
+size_t      NumberToChars(double d, char* buffer);
+size_t      NumberToChars(int64_t i, char* buffer);
 double      ValueToDouble(const Value& v);
 double      ValueToDoubleOrZero(const Value& v);
 int64_t     ValueToInt(const Value& v);
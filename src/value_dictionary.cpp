@@ -0,0 +1,150 @@
+#include "value_dictionary.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace BA67 {
+
+static inline uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+size_t ValueDictionary::hash(const Value& key) {
+    uint64_t h = 0;
+    switch (key.index()) {
+    case 0: h = uint64_t(std::get<int64_t>(key)); break;
+    case 1: {
+        double d = std::get<double>(key);
+        if (d == 0.0) {
+            d = 0.0; // -0.0 == 0.0
+        }
+        std::memcpy(&h, &d, sizeof(h));
+        break;
+    }
+    case 2: h = std::hash<std::string_view> {}(std::get<std::string>(key)); break;
+    case 3: h = std::hash<std::string_view> {}(std::get<Operator>(key).value); break;
+    }
+    // int 1 and double 1.0 are different keys
+    return size_t(mix64(h + key.index() * 0x9e3779b97f4a7c15ULL));
+}
+
+// slot holding key, or the EMPTY slot where the probe ended
+size_t ValueDictionary::findSlot(const Value& key) const {
+    size_t mask = slots.size() - 1;
+    size_t i    = hash(key) & mask;
+    for (;;) {
+        uint32_t s = slots[i];
+        if (s == EMPTY) {
+            return i;
+        }
+        if (s != TOMBSTONE && items[s - 1].key == key) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+size_t ValueDictionary::find(const Value& key) const {
+    if (count == 0) {
+        return npos;
+    }
+    uint32_t s = slots[findSlot(key)];
+    return s == EMPTY ? npos : size_t(s - 1);
+}
+
+size_t ValueDictionary::findOrInsert(const Value& key) {
+    // keep the load factor (including tombstones) below 3/4
+    if ((used + 1) * 4 > slots.size() * 3) {
+        rehash(std::max(size_t(16), std::bit_ceil((count + 1) * 2)));
+    }
+
+    size_t i = findSlot(key);
+    if (slots[i] != EMPTY) {
+        return slots[i] - 1;
+    }
+    items.push_back({ key, Value {}, true });
+    slots[i] = uint32_t(items.size());
+    ++count;
+    ++used;
+    return items.size() - 1;
+}
+
+bool ValueDictionary::erase(const Value& key) {
+    if (count == 0) {
+        return false;
+    }
+    size_t i = findSlot(key);
+    if (slots[i] == EMPTY) {
+        return false;
+    }
+    Entry& e = items[slots[i] - 1];
+    e.alive  = false;
+    e.key    = Value {};
+    e.value  = Value {};
+    slots[i] = TOMBSTONE;
+    --count;
+
+    // drop the dead entries once they dominate
+    if (items.size() > 16 && count < items.size() / 2) {
+        compact();
+    }
+    return true;
+}
+
+void ValueDictionary::clear() {
+    items.clear();
+    slots.clear();
+    count = 0;
+    used  = 0;
+}
+
+std::vector<Value> ValueDictionary::keys() const {
+    std::vector<Value> k;
+    k.reserve(count);
+    for (auto& e : items) {
+        if (e.alive) {
+            k.push_back(e.key);
+        }
+    }
+    return k;
+}
+
+// capacity must be a power of 2. Dead entries get no slot, but keep their place in items.
+void ValueDictionary::rehash(size_t capacity) {
+    slots.assign(capacity, EMPTY);
+    used = count;
+
+    size_t mask = capacity - 1;
+    for (size_t n = 0; n < items.size(); ++n) {
+        if (!items[n].alive) {
+            continue;
+        }
+        size_t i = hash(items[n].key) & mask;
+        while (slots[i] != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = uint32_t(n + 1);
+    }
+}
+
+void ValueDictionary::compact() {
+    std::vector<Entry> alive;
+    alive.reserve(count);
+    for (auto& e : items) {
+        if (e.alive) {
+            alive.push_back(std::move(e));
+        }
+    }
+    items.swap(alive);
+    rehash(slots.size());
+}
+
+} // namespace BA67
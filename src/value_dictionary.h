@@ -0,0 +1,54 @@
+#pragma once
+#include "value.h"
+#include <cstdint>
+#include <vector>
+
+namespace BA67 {
+
+// Hash map Value -> Value for DIM A$() dictionaries.
+// Open addressing with linear probing. The entries are kept in
+// insertion order, so iteration (DUMP, KEYS) is deterministic.
+// Entry indices stay valid across inserts. Only erase() compacts the table,
+// so an index of A$(K$) survives the inserts of the right-hand side.
+class ValueDictionary {
+public:
+    struct Entry {
+        Value key;
+        Value value;
+        bool alive = true;
+    };
+    static constexpr size_t npos = size_t(-1);
+
+    // index of the entry. Inserts an empty value for a new key.
+    size_t findOrInsert(const Value& key);
+    // index of the entry or npos
+    size_t find(const Value& key) const;
+    bool erase(const Value& key);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Value& valueAt(size_t index) { return items[index].value; }
+    const Value& valueAt(size_t index) const { return items[index].value; }
+
+    // all entries in insertion order. Skip the ones that are not alive.
+    const std::vector<Entry>& entries() const { return items; }
+    std::vector<Value> keys() const;
+
+    static size_t hash(const Value& key);
+
+private:
+    static constexpr uint32_t EMPTY     = 0;
+    static constexpr uint32_t TOMBSTONE = 0xffffffff;
+
+    std::vector<Entry> items;
+    std::vector<uint32_t> slots; // EMPTY, TOMBSTONE or index into items + 1
+    size_t count = 0; // alive entries
+    size_t used  = 0; // slots that are not EMPTY
+
+    size_t findSlot(const Value& key) const;
+    void rehash(size_t capacity); // new slots, the entries keep their index
+    void compact(); // drop the dead entries. Moves the indices.
+};
+
+} // namespace BA67
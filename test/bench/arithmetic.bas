@@ -0,0 +1,6 @@
+10 REM ARITHMETIC EXPRESSIONS
+20 A=1.5:B=3
+30 FOR I=1 TO 100000
+40 C=A*B+I/7-(A-B)*2
+50 D%=I AND 255
+60 NEXT
@@ -0,0 +1,6 @@
+10 REM ARRAY READ AND WRITE
+20 DIM A(511)
+30 FOR I=0 TO 99999
+40 J=I AND 511
+50 A(J)=A(J)+I
+60 NEXT
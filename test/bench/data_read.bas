@@ -0,0 +1,7 @@
+10 REM DATA AND READ
+20 FOR I=1 TO 10000
+30 RESTORE
+40 FOR J=1 TO 10:READ A:NEXT
+50 NEXT
+60 END
+100 DATA 1,2,3,4,5,6,7,8,9,10
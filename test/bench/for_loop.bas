@@ -0,0 +1,2 @@
+10 REM EMPTY FOR LOOP
+20 FOR I=1 TO 500000:NEXT
@@ -0,0 +1,6 @@
+10 REM GOSUB AND RETURN
+20 FOR I=1 TO 100000
+30 GOSUB 100
+40 NEXT
+50 END
+100 RETURN
@@ -0,0 +1,5 @@
+10 REM MID$ SLICING
+20 A$="THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG"
+30 FOR I=1 TO 100000
+40 B$=MID$(A$,(I AND 31)+1,5)
+50 NEXT
@@ -0,0 +1,4 @@
+10 REM PRINT TO THE SCREEN
+20 FOR I=1 TO 20000
+30 PRINT "HELLO WORLD";I
+40 NEXT
@@ -0,0 +1,4 @@
+10 REM RND
+20 FOR I=1 TO 10000
+30 A=RND(1)
+40 NEXT
@@ -0,0 +1,6 @@
+10 REM STRING CONCATENATION
+20 A$=""
+30 FOR I=1 TO 100000
+40 A$=A$+"X"
+50 IF LEN(A$)>200 THEN A$=""
+60 NEXT
@@ -0,0 +1,5 @@
+10 REM 6502 MACHINE CODE LOOP
+20 FOR I=0 TO 10:READ B:POKE 49152+I,B:NEXT
+30 FOR I=1 TO 20:SYS 49152:NEXT
+40 END
+100 DATA 162,0,160,0,136,208,253,202,208,250,96
@@ -53,7 +53,23 @@
 340 GOSUB 500
 350 IF (R)<>(42) THEN ER=1:PRINT "ERROR: GOSUB/RETURN"
 360 PRINT "  GOSUB AND RETURN PASSED. ER";ER
-370 PRINT "  TESTING PRINT SPACING..."
+361 PRINT "  TESTING DICTIONARIES..."
+362 DIM D(): FOR I=1 TO 47: D("K"+STR$(I))=I: NEXT I
+363 FOR I=1 TO 23: ERASE D("K"+STR$(I)): NEXT I
+364 D("NEW")=D("OTHER")+5: REM THE RIGHT SIDE INSERTS A KEY AND GROWS THE TABLE
+365 IF D("NEW")<>5 OR D()<>26 THEN ER=1:PRINT "ERROR: DICTIONARY INSERT AFTER ERASE"
+366 IF D("K47")<>47 THEN ER=1:PRINT "ERROR: DICTIONARY LOOKUP"
+367 PRINT "  DICTIONARIES PASSED. ER";ER
+368 PRINT "  TESTING COLLISIONS..."
+369 SPRDEF 1,"######":SPRDEF 2,"######":SPRITE 1,1,2,0,0,0:SPRITE 2,1,3,0,0,0:C$=""
+370 MOVSPR 1,585,90:MOVSPR 2,425,90:COLLISION 1,510:COLLISION 2,520
+371 MOVSPR 2,569,90:FOR I=1 TO 50:NEXT:S$=C$:MOVSPR 2,425,90
+372 CHAR ,68,5,"#":MOVSPR 2,569,90:FOR I=1 TO 50:NEXT:REM BOTH CONTACTS START TOGETHER
+373 COLLISION 1:COLLISION 2:SPRITE 1,0:SPRITE 2,0:CHAR ,68,5," "
+374 IF S$<>"S" THEN ER=1:PRINT "ERROR: SPRITE COLLISION ";S$
+375 IF C$<>"SSB" THEN ER=1:PRINT "ERROR: SPRITE AND BACKGROUND COLLISION ";C$
+376 PRINT "  COLLISIONS PASSED. ER";ER
+377 PRINT "  TESTING PRINT SPACING..."
 380 PRINT "  ..."; ",,";"...X--- SEMICOLON"
 390 PRINT "  ...","X--- COMMA"
 400 PRINT SPC(5); ",,,,,X--- SPACED"
@@ -63,3 +79,5 @@
 440 QUIT ER:REM FOR TESTING
 450 END
 500 R=42: RETURN
+510 C$=C$+"S":RETURN
+520 C$=C$+"B":RETURN